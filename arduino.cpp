@@ -1,52 +1,254 @@
-#include <arduino.h>
-#include <Windows.h>
+#include <Arduino.h>
+#include "sim_device.h"
 
 
 unsigned long millis()
 {
-    return GetTickCount();
+    return SimClock.millis();
 }
 
+void delay(unsigned long ms)
+{
+    sim_wait(SimClock.micros() + ms * 1000ULL);
+}
+
+bool sim_wait(uint64_t until_us)
+{
+    CSimDevice& device = sim_device();
+
+    // Make sure the virtual clock doesn't idle past the moment we're waiting for
+    SimClock.add_deadline(until_us);
+
+    // Just like on the hardware, interrupts (and the outside world) carry on while we wait.  Anything
+    // that falls due at the very moment we're waiting for has happened by the time we return
+    while (true)
+    {
+        if (SimStimulus.is_finished()) return false;
+        SimScheduler.run_due();
+        SimIrq.service();
+        if (SimClock.micros() >= until_us) return true;
+        bool keep_going = device.host ? device.host->idle(SimClock, until_us) : SimClock.idle(until_us);
+        if (!keep_going) return false;
+    }
+}
+
+void sim_deadline(unsigned long when_ms)
+{
+    // How many milliseconds from now is this deadline?
+    long delta_ms = (long)(when_ms - millis());
+
+    // A deadline in the past is due right now
+    if (delta_ms < 0) delta_ms = 0;
+
+    // Tell the virtual clock when this deadline arrives
+    SimClock.add_deadline(SimClock.micros() + delta_ms * 1000ULL);
+}
+
+void sim_busy()
+{
+    // A deadline that has already arrived gets thrown away, so ask for the very next microsecond
+    SimClock.add_deadline(SimClock.micros() + 1);
+}
+
+
+//=========================================================================================================
+// The pin model.  Digital pins 0 thru 31 map onto ports B, D, C, and A, eight pins per port, which is
+// the "Mighty 1284" layout that CRotaryKnob::configure_INT() and configure_PCINT() assume
+//=========================================================================================================
+#define input_signal (sim_device().pin_signal)
+#define input_driven (sim_device().pin_driven)
+
+// This translates the bank-number of a pin into a PCINT vector number
+static const int bank_to_pcint[] = { 1, 3, 2, 0 };
+
+// The PORT and DDR registers for each bank of eight pins
+static int& bank_port(int bank)
+{
+    switch (bank)
+    {
+        case 0:  return PORTB;
+        case 1:  return PORTD;
+        case 2:  return PORTC;
+        default: return PORTA;
+    }
+}
+
+static int& bank_ddr(int bank)
+{
+    switch (bank)
+    {
+        case 0:  return DDRB;
+        case 1:  return DDRD;
+        case 2:  return DDRC;
+        default: return DDRA;
+    }
+}
+
+// The pin-change mask register for each PCINT vector
+static int& pcint_mask(int PCINT)
+{
+    switch (PCINT)
+    {
+        case 0:  return PCMSK0;
+        case 1:  return PCMSK1;
+        case 2:  return PCMSK2;
+        default: return PCMSK3;
+    }
+}
+//=========================================================================================================
 
-static int input_signal[256];
 
+//=========================================================================================================
+// digitalPinToInterrupt() - Returns the INTn number for a pin, or NOT_AN_INTERRUPT
+//=========================================================================================================
+int digitalPinToInterrupt(int pin)
+{
+    switch (pin)
+    {
+        case 10: return 0;  // INT0/PD2
+        case 11: return 1;  // INT1/PD3
+        case 2:  return 2;  // INT2/PB2
+    }
+    return NOT_AN_INTERRUPT;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_pin_edge() - Raises whichever interrupts the registers say an edge on this pin should cause
+//=========================================================================================================
+static void on_pin_edge(int pin, int state)
+{
+    // If this pin is an INT pin, check the sense-control bits for this INT in EICRA
+    int INT = digitalPinToInterrupt(pin);
+    if (INT != NOT_AN_INTERRUPT)
+    {
+        bool fire = false;
+        switch ((EICRA >> (INT << 1)) & 3)
+        {
+            case LOW:     fire = (state == 0); break;
+            case CHANGE:  fire = true;         break;
+            case FALLING: fire = (state == 0); break;
+            case RISING:  fire = (state != 0); break;
+        }
+        if (fire) SimIrq.raise(INT0_vect_num + INT);
+    }
+
+    // Pins outside of the four ports can't cause pin-change interrupts
+    if (pin < 0 || pin >= 32) return;
+
+    // Find out which PCINT vector this pin belongs to
+    int PCINT = bank_to_pcint[pin >> 3];
+
+    // If this pin is selected in its pin-change mask register, raise the PCINT
+    if (pcint_mask(PCINT) & (1 << (pin & 7))) SimIrq.raise(PCINT0_vect_num + PCINT);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// sim_input() - Drives an input pin to a given state.  Edges cause interrupts just like real hardware
+//=========================================================================================================
 void sim_input(int pin, int state)
 {
-    input_signal[pin] = state;
+    if (pin < 0 || pin >= 256) return;
+
+    // Find out what the pin read before we drove it
+    int old_state = digitalRead(pin);
+
+    // Drive the pin
+    input_signal[pin] = (state != 0);
+    input_driven[pin] = true;
+
+    // If that caused an edge, raise any interrupts that edge causes, and deliver them
+    if (input_signal[pin] != old_state)
+    {
+        on_pin_edge(pin, input_signal[pin]);
+        SimIrq.service();
+    }
 }
+//=========================================================================================================
 
+
+//=========================================================================================================
+// digitalRead() - An undriven input pin reads high if its pull-up is enabled
+//=========================================================================================================
 int digitalRead(int pin)
 {
-    return input_signal[pin];
+    if (pin < 0 || pin >= 256) return 0;
+
+    // If the simulation is driving the pin, report what it's being driven to
+    if (input_driven[pin]) return input_signal[pin];
+
+    // Otherwise, it reads as high only if it's an input with the pull-up enabled
+    if (pin >= 32) return 0;
+    int mask = 1 << (pin & 7);
+    return (bank_ddr(pin >> 3) & mask) == 0 && (bank_port(pin >> 3) & mask) != 0;
 }
+//=========================================================================================================
 
 
-void pinMode(int pin, int state) {}
+//=========================================================================================================
+// pinMode() - Configures the DDR and PORT bits for a pin
+//=========================================================================================================
+void pinMode(int pin, int mode)
+{
+    if (pin < 0 || pin >= 32) return;
 
-void attachInterrupt(int a, void(*fn)(), int b) {}
+    int& ddr  = bank_ddr(pin >> 3);
+    int& port = bank_port(pin >> 3);
+    int  mask = 1 << (pin & 7);
+
+    switch (mode)
+    {
+        case INPUT:        ddr &= ~mask; port &= ~mask; break;
+        case INPUT_PULLUP: ddr &= ~mask; port |=  mask; break;
+        case OUTPUT:       ddr |=  mask;                break;
+    }
+}
+//=========================================================================================================
 
-void cli() {}
-void sei() {}
 
+//=========================================================================================================
+// attachInterrupt() - Installs a handler for INTn and configures EICRA and EIMSK for it
+//
+// Passed: irq  = The INTn number (see digitalPinToInterrupt())
+//         fn   = The handler
+//         mode = LOW, CHANGE, FALLING, or RISING
+//=========================================================================================================
+void attachInterrupt(int irq, void(*fn)(), int mode)
+{
+    if (irq < 0 || irq > 2) return;
 
-int PORTA, PORTB, PORTC, PORTD;
-int DDRA, DDRB, DDRC, DDRD;
-int PCMSK0, PCMSK1, PCMSK2, PCMSK3;
+    // Install the handler in this device's vector table
+    SimIrq.attach(INT0_vect_num + irq, fn);
 
-int PORTB0;
-int PCIFR;
-int PCIF1;
-int PCICR;
-int PCIE1;
-int PCINT8;
+    // Configure the sense-control bits for this INT
+    EICRA = (EICRA & ~(3 << (irq << 1))) | ((mode & 3) << (irq << 1));
+
+    // Clear any stale pending interrupt and enable this INT
+    EIFR  |= (1 << irq);
+    EIMSK |= (1 << irq);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// detachInterrupt() - Disables INTn
+//=========================================================================================================
+void detachInterrupt(int irq)
+{
+    if (irq < 0 || irq > 2) return;
+    EIMSK &= ~(1 << irq);
+    SimIrq.attach(INT0_vect_num + irq, nullptr);
+}
+//=========================================================================================================
 
-int EICRA;
-int EIMSK;
-int EIFR;
 
+void cli() { SimIrq.cli(); }
+void sei() { SimIrq.sei(); }
 
 
-CArduinoWire Wire;
 
 unsigned char pgm_read_byte_near(const unsigned char* ptr)
 {
@@ -0,0 +1,134 @@
+#pragma once
+#include <stdint.h>
+#include <Wire.h>
+#include <HardwareSerial.h>
+
+#define PROGMEM
+
+unsigned char pgm_read_byte_near(const unsigned char* ptr);
+
+
+unsigned long millis();
+void delay(unsigned long ms);
+
+// Simulator only: tells the virtual clock that something becomes due at the given millis() value
+void sim_deadline(unsigned long when_ms);
+
+// Simulator only: tells the virtual clock that loop() has more work to do, so it gets called again
+// right away instead of idling until the next deadline
+void sim_busy();
+
+// Simulator only: busy-waits until the given virtual time (in microseconds).  Scheduled events and
+// interrupts keep firing while we wait.  Returns false if the simulation ended first
+bool sim_wait(uint64_t until_us);
+
+#define LOW             0
+#define HIGH            1
+
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define NOT_AN_INTERRUPT -1
+
+int digitalRead(int pin);
+
+// Simulator only: drives an input pin.  Edges raise INTn/PCINTn interrupts according to the registers
+void sim_input(int pin, int state);
+
+void pinMode(int pin, int mode);
+
+int  digitalPinToInterrupt(int pin);
+void attachInterrupt(int irq, void(*fn)(), int mode);
+void detachInterrupt(int irq);
+
+void cli();
+void sei();
+
+// Interrupt vector numbers, as laid out in the ATmega1284P vector table
+#define INT0_vect_num       1
+#define INT1_vect_num       2
+#define INT2_vect_num       3
+#define PCINT0_vect_num     4
+#define PCINT1_vect_num     5
+#define PCINT2_vect_num     6
+#define PCINT3_vect_num     7
+#define EE_READY_vect_num   25
+#define SIM_VECTOR_COUNT    31
+
+// Simulator only: places an ISR into the simulated vector table.  The ISR() macro does this for you
+bool sim_register_isr(int vector, void (*isr)());
+
+// Declares an ISR and registers it in the simulated vector table
+#define ISR(vector) void vector(); \
+                    static bool vector##_registered = sim_register_isr(vector##_num, vector); \
+                    void vector()
+
+//---------------------------------------------------------------------------------------------------------
+// An interrupt-flag register.  Just like the hardware, writing a 1 to a bit clears that bit.  Only the
+// simulated interrupt controller can set bits, via set()
+//---------------------------------------------------------------------------------------------------------
+class CSimFlagReg
+{
+public:
+    CSimFlagReg() { m_value = 0; }
+    operator int() const { return m_value; }
+    CSimFlagReg& operator|=(int bits) { m_value &= ~bits; return *this; }
+    CSimFlagReg& operator= (int bits) { m_value &= ~bits; return *this; }
+    void         set(int bits)        { m_value |= bits; }
+protected:
+    int m_value;
+};
+//---------------------------------------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------------------------------------
+// The I/O registers.  Every simulated device has its own set, so the register names are macros that
+// refer to the registers of the device that is running on the current thread
+//---------------------------------------------------------------------------------------------------------
+struct sim_regs_t
+{
+    int PORTA, PORTB, PORTC, PORTD;
+    int DDRA, DDRB, DDRC, DDRD;
+    int PCMSK0, PCMSK1, PCMSK2, PCMSK3;
+
+    CSimFlagReg PCIFR;
+    int         PCICR;
+
+    int         EICRA;
+    int         EIMSK;
+    CSimFlagReg EIFR;
+
+    int         EECR;
+};
+
+sim_regs_t& sim_regs();
+
+#define PORTA   (sim_regs().PORTA)
+#define PORTB   (sim_regs().PORTB)
+#define PORTC   (sim_regs().PORTC)
+#define PORTD   (sim_regs().PORTD)
+#define DDRA    (sim_regs().DDRA)
+#define DDRB    (sim_regs().DDRB)
+#define DDRC    (sim_regs().DDRC)
+#define DDRD    (sim_regs().DDRD)
+#define PCMSK0  (sim_regs().PCMSK0)
+#define PCMSK1  (sim_regs().PCMSK1)
+#define PCMSK2  (sim_regs().PCMSK2)
+#define PCMSK3  (sim_regs().PCMSK3)
+#define PCIFR   (sim_regs().PCIFR)
+#define PCICR   (sim_regs().PCICR)
+#define EICRA   (sim_regs().EICRA)
+#define EIMSK   (sim_regs().EIMSK)
+#define EIFR    (sim_regs().EIFR)
+#define EECR    (sim_regs().EECR)
+//---------------------------------------------------------------------------------------------------------
+
+#define PORTB0  0
+#define PCIF1   1
+#define PCIE1   1
+#define PCINT8  0
+#define EERIE   3
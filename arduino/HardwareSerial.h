@@ -0,0 +1,134 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+
+// Just like the AVR core, the ring sizes can be overridden at compile time
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64
+#endif
+#ifndef SERIAL_TX_BUFFER_SIZE
+#define SERIAL_TX_BUFFER_SIZE 64
+#endif
+
+// Frame formats for begin().  These are the AVR's UCSRnC values, same as the AVR core
+#define SERIAL_7N1 0x04
+#define SERIAL_8N1 0x06
+#define SERIAL_7N2 0x0C
+#define SERIAL_8N2 0x0E
+#define SERIAL_7E1 0x24
+#define SERIAL_8E1 0x26
+#define SERIAL_7E2 0x2C
+#define SERIAL_8E2 0x2E
+#define SERIAL_7O1 0x34
+#define SERIAL_8O1 0x36
+#define SERIAL_7O2 0x3C
+#define SERIAL_8O2 0x3E
+
+//---------------------------------------------------------------------------------------------------------
+// The simulated UART.  Like the AVR core's HardwareSerial, received bytes wait in a small RX ring until
+// the firmware reads them, and transmitted bytes wait in a small TX ring until the UART sends them.
+//
+// The UART runs at the baud rate and frame format given to begin(), in virtual time: each byte takes
+// one frame time to shift out or to arrive.  A byte that arrives while the RX ring is full is lost, and
+// a write() to a full TX ring waits (with interrupts and stimulus still running) until there's room.
+//
+// On the simulator side, the port is either attached to a pseudo-terminal (so that host tools can talk
+// to it exactly as they would talk to real hardware), or else received bytes are injected by the
+// stimulus player and transmitted lines are logged.
+//---------------------------------------------------------------------------------------------------------
+class CArduinoSerial
+{
+public:
+
+    enum { RX_BUFFER_SIZE = SERIAL_RX_BUFFER_SIZE, TX_BUFFER_SIZE = SERIAL_TX_BUFFER_SIZE };
+
+    // Traffic counters, for measuring throughput
+    struct stats_t
+    {
+        uint32_t rx_bytes, tx_bytes;    // Bytes that made it into the RX ring / out of the UART
+        uint32_t rx_dropped;            // Bytes that arrived while the RX ring was full (overruns)
+        uint32_t tx_dropped;            // Bytes that couldn't be sent at all
+        uint64_t tx_stall_us;           // Virtual time the firmware spent waiting for room in the TX ring
+    };
+
+    CArduinoSerial();
+    ~CArduinoSerial();
+
+    // Copies carry the buffered data and counters, but never the pseudo-terminal
+    CArduinoSerial(const CArduinoSerial& rhs);
+    CArduinoSerial& operator=(const CArduinoSerial& rhs);
+
+    // The Arduino API
+    void    begin(unsigned long baud, uint8_t config = SERIAL_8N1);
+    void    end() { m_frame_us = 0; }
+    int     available();
+    int     availableForWrite();
+    int     peek();
+    int     read();
+    void    flush();
+    size_t  write(uint8_t c);
+    size_t  write(const void* buffer, size_t length);
+    size_t  print(const char* text);
+    size_t  println(const char* text = "");
+    operator bool() { return true; }
+
+    // Simulator only: attaches the port to a new pseudo-terminal and returns the name of the slave
+    // device that host tools should open, or nullptr if that's not possible
+    const char* open_pty();
+
+    // Simulator only: puts bytes on the RX wire.  They arrive in the RX ring one frame time apart
+    void    inject(const void* data, size_t length);
+
+    // Simulator only: puts bytes waiting on the pseudo-terminal onto the RX wire
+    void    poll_pty();
+
+    // Simulator only: fetches the traffic counters and the configuration
+    const stats_t& get_stats() { return m_stats; }
+    unsigned long  get_baud()  { return m_baud; }
+
+protected:
+
+    // Start shifting the next byte in or out
+    void    start_tx();
+    void    start_rx();
+
+    // Scheduled when a byte finishes shifting out or in
+    static void on_tx_done(const char*);
+    static void on_rx_done(const char*);
+
+    // Hands a byte that has finished transmitting to the pseudo-terminal or the log
+    void    emit(uint8_t c);
+
+    // The ring buffers.  "head" is where the next byte is stored, "tail" is where the next byte is taken
+    uint8_t  m_rx[RX_BUFFER_SIZE], m_tx[TX_BUFFER_SIZE];
+    uint16_t m_rx_head, m_rx_tail, m_tx_head, m_tx_tail;
+
+    // Bytes the host has sent that haven't finished arriving yet
+    std::deque<uint8_t> m_rx_wire;
+
+    // The byte in the transmit shift register, whether each direction is busy, and when the byte
+    // currently being transmitted will be done
+    uint8_t  m_tx_shift;
+    bool     m_is_tx_busy, m_is_rx_busy;
+    uint64_t m_tx_done_us;
+
+    // When there's no pseudo-terminal, transmitted bytes are collected here until a line is complete
+    char     m_line[128];
+    size_t   m_line_length;
+
+    // The baud rate the firmware asked for, and how long (in microseconds) one frame takes.  A frame
+    // time of 0 means the port hasn't been opened
+    unsigned long m_baud;
+    uint32_t m_frame_us;
+
+    // The pseudo-terminal master and slave, or -1 if there isn't one
+    int      m_pty_master, m_pty_slave;
+
+    // Traffic counters
+    stats_t  m_stats;
+};
+
+// Every simulated device has its own serial port
+CArduinoSerial& sim_serial();
+#define Serial (sim_serial())
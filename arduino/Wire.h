@@ -0,0 +1,107 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Same transmit/receive buffer size as the AVR Wire library
+#define BUFFER_LENGTH 32
+
+class CSimI2CDevice;
+
+//---------------------------------------------------------------------------------------------------------
+// The simulated I2C bus.  Device models (see sim_i2c.h) are attached at their 7-bit address, and
+// transactions are routed to them byte by byte.  A transaction to an address with nothing attached is
+// NACKed, exactly as on a real bus.
+//
+// Every transaction costs bus time at the rate given to setClock().  Just like the AVR Wire library, the
+// caller busy-waits until the transaction is done, so that time passes on the virtual clock.
+//---------------------------------------------------------------------------------------------------------
+class CArduinoWire
+{
+public:
+
+    // Results of endTransmission() and transmit(), same as the AVR library
+    enum { I2C_OK = 0, I2C_TOO_LONG = 1, I2C_ADDRESS_NACK = 2, I2C_DATA_NACK = 3, I2C_OTHER = 4 };
+
+    // Traffic counters, for measuring what the bus costs
+    struct stats_t
+    {
+        uint32_t transactions;          // Every START (or repeated START)
+        uint32_t bytes;                 // Data bytes written and read, not counting address bytes
+        uint32_t nacks;                 // Transactions that ended early because of a NACK
+        uint64_t bus_ns;                // Total time the bus was busy
+    };
+
+    CArduinoWire();
+
+    // Copies carry the bus state and counters.  The attached device models stay where they are
+    CArduinoWire(const CArduinoWire& rhs) : CArduinoWire() { *this = rhs; }
+    CArduinoWire& operator=(const CArduinoWire& rhs);
+
+    // The Arduino API
+    void    begin() {}
+    void    end() {}
+    void    setClock(uint32_t clock) { m_clock = clock; }
+    void    beginTransmission(uint8_t address);
+    uint8_t endTransmission(bool send_stop = true);
+    size_t  write(uint8_t data);
+    size_t  write(const void* buffer, size_t length);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool send_stop = true);
+    int     available() { return m_rx_length - m_rx_index; }
+    int     read();
+    int     peek();
+    void    flush() {}
+
+    // Raw bus transactions.  The Wire API above and the twi_xxx() routines are built on these.
+    // transmit() returns one of the I2C_xxx results, receive() returns the number of bytes read
+    uint8_t transmit(uint8_t address, const uint8_t* data, size_t length, bool send_stop);
+    size_t  receive(uint8_t address, uint8_t* data, size_t length, bool send_stop);
+
+    // Simulator only: attaches (or with nullptr, detaches) a device model at a 7-bit address
+    void    attach(uint8_t address, CSimI2CDevice* device);
+
+    // Simulator only: fetches the traffic counters and the bus clock
+    const stats_t& get_stats() { return m_stats; }
+    uint32_t       get_clock() { return m_clock; }
+
+protected:
+
+    // Issues a START (or a repeated START) and the address byte.  Returns the addressed device, or
+    // nullptr if nobody ACKed
+    CSimI2CDevice* start(uint8_t address, bool is_read);
+
+    // Issues a STOP
+    void    stop();
+
+    // Adds "bits" bit-times to the bus time of the transaction in progress
+    void    charge(uint32_t bits);
+
+    // Lets virtual time pass while the transaction we just performed is on the wire
+    void    wait_for_bus();
+
+    // The attached device models, indexed by 7-bit address
+    CSimI2CDevice* m_device[128];
+
+    // The device that currently has the bus (after a transaction that ended without a STOP), or nullptr
+    CSimI2CDevice* m_holder;
+
+    // The bus clock in Hz
+    uint32_t m_clock;
+
+    // Bus time (in nanoseconds) that hasn't been waited out yet
+    uint64_t m_owed_ns;
+
+    // The transmit buffer filled by write(), and the address it's headed for
+    uint8_t  m_tx_buffer[BUFFER_LENGTH];
+    uint8_t  m_tx_length, m_tx_address;
+
+    // The receive buffer filled by requestFrom()
+    uint8_t  m_rx_buffer[BUFFER_LENGTH];
+    uint8_t  m_rx_length, m_rx_index;
+
+    // Traffic counters
+    stats_t  m_stats;
+};
+
+// Every simulated device has its own I2C bus
+CArduinoWire& sim_wire();
+#define Wire (sim_wire())
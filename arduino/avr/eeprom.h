@@ -1,6 +1,18 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 void eeprom_update_block(const void* src, void* dest, size_t count);
 void eeprom_read_block( void* dest, const void* src, size_t count);
 void eeprom_write_byte(uint8_t* addr, uint8_t value);
+void eeprom_update_byte(uint8_t* addr, uint8_t value);
+
+// True when the EEPROM isn't busy programming a byte
+bool eeprom_is_ready();
+
+// Simulator only: returns false if the most recent eeprom_* call hit an injected I/O failure
+bool sim_eeprom_status();
+
+// Simulator only: marks the start and finish of a CEEPROM_Base API call, so that the time it spends
+// blocked on the EEPROM can be measured
+void sim_eeprom_api(int api, bool is_finished);
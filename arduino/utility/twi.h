@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+
+// The low-level TWI routines that the AVR Wire library is built on.  In the simulator they run on the
+// current device's I2C bus (see Wire.h), so they behave exactly like Wire does, bus timing included
+
+#ifndef TWI_FREQ
+#define TWI_FREQ 100000L
+#endif
+
+#ifndef TWI_BUFFER_LENGTH
+#define TWI_BUFFER_LENGTH 32
+#endif
+
+void    twi_init(void);
+void    twi_disable(void);
+void    twi_setFrequency(uint32_t frequency);
+uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t send_stop);
+uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait, uint8_t send_stop);
@@ -1,8 +1,32 @@
 #pragma once
 
-#define CHANNEL_A 1
-#define CHANNEL_B 2
+// Rotary channel A must be on an INT pin (INT1/PD3), the click-button on a PCINT pin (PCINT11/PB3)
+#define CHANNEL_A 11
+#define CHANNEL_B 12
 #define CLICK_PIN 3
 
-#define INPUT 0
-#define CHANGE 0
\ No newline at end of file
+// The I2C address of the IS31FL3731 LED matrix driver
+#define LED_I2C_ADDRESS 0x74
+
+// The LED matrix board (see led_geometry.h), and how many of them sit side by side.  Each board has
+// its own IS31FL3731, at LED_I2C_ADDRESS + its position from the left
+#ifndef LED_GEOMETRY
+#define LED_GEOMETRY    CharlieWing15x7
+#endif
+#ifndef LED_CHIPS
+#define LED_CHIPS       1
+#endif
+
+// The I2C address of the SHT31 temperature/humidity sensor
+#define SHT31_I2C_ADDRESS 0x44
+
+// The baud rate of the serial command port
+#ifndef SERIAL_BAUD
+#define SERIAL_BAUD 115200
+#endif
+
+// The firmware revision reported by the "fwrev" command
+#define FW_VERSION "1.0.0"
+
+// These are the values that CEEPROM::data_t::run_mode can take
+enum { MANUAL = 0, SETPOINT = 2 };
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stddef.h>
 #include "eeprom_base.h"
 #include "crc32.h"
 
@@ -14,6 +15,13 @@
 // This is how we denote an empty slot in the cache
 #define EMPTY_SLOT 0xFFFFFFFF
 
+// Where the magic number sits in a header.  Erasing its first byte is enough to invalidate it
+#define MAGIC_OFFSET offsetof(header_t, magic)
+
+// A delta map has one bit per chunk of the data (not counting the header)
+#define DELTA_CHUNKS 32
+#define ALL_CHUNKS   0xFFFFFFFF
+
 
 //=========================================================================================================
 // Constructor() - Saves wear-leveling setup information and initializes our internal data-descriptor
@@ -24,7 +32,10 @@ CEEPROM_Base::CEEPROM_Base()
     m_data = { nullptr, 0, 0, nullptr };
 
     // Set up default wear-leveling parameters (i.e., no wear-leveling)
-    m_wl = { 1, 0, nullptr };
+    m_wl = { 1, 0, nullptr, nullptr };
+
+    // Background writes are only possible once the derived class supplies a buffer
+    m_async = { nullptr, 0, 0, 0, 0, 0, 0, nullptr };
 
     // By default we perform "dirty checking" on the data structure prior to writing it to physical EEPROM
     m_is_dirty_checking = true;
@@ -49,6 +60,12 @@ bool CEEPROM_Base::read()
 {
     uint16_t address;
 
+    // Let the derived class know we're at work
+    api_scope_t scope(this, api_t::READ);
+
+    // A background write has to finish before we touch the EEPROM
+    finish_async();
+
     // Presume for a moment that this routine is going to succeed
     m_error = error_t::OK;
         
@@ -101,6 +118,9 @@ bool CEEPROM_Base::read()
     // The data structure in RAM now matches the data structure in EEPROM
     mark_data_as_clean();
 
+    // Find out how each slot differs from what's now in RAM
+    build_delta_maps();
+
     // Tell the caller whether we were able to read the EEPROM
     return (m_error == error_t::OK);
 }
@@ -117,6 +137,12 @@ bool CEEPROM_Base::write(bool force_write)
     uint16_t address;
     int      slot;
 
+    // Let the derived class know we're at work
+    api_scope_t scope(this, api_t::WRITE);
+
+    // A background write has to finish before we touch the EEPROM
+    finish_async();
+
     // Presume for a moment that this routine is going to succeed
     m_error = error_t::OK;
 
@@ -126,6 +152,85 @@ bool CEEPROM_Base::write(bool force_write)
     // If we're not forcing the write, and the data isn't "dirty", don't commit it to EEPROM
     if (!force_write && !is_dirty()) return true;
 
+    // Find any changes that were made without going through set()
+    find_changes();
+
+    // Fill in the header and find the EEPROM address where this edition should be written
+    if (!prepare_write(&address, &slot))
+    {
+        m_error = error_t::IO;
+        return false;
+    }
+
+    // If we're caching, cache this entry
+    if (m_wl.cache) m_wl.cache[slot] = m_header.edition;
+
+    // Write the header and data structure to EEPROM.  With delta maps, only the parts of the data that
+    // this slot doesn't already hold get written
+    if (m_wl.delta)
+    {
+        if (!write_delta(address, m_wl.delta[slot])) m_error = error_t::IO;
+        m_wl.delta[slot] = (m_error == error_t::OK) ? 0 : ALL_CHUNKS;
+    }
+    else if (!write_physical_block(m_data.ptr, address, m_data.length))
+    {
+        m_error = error_t::IO;
+    }
+
+    // The data structure in RAM now matches the data structure in EEPROM
+    mark_data_as_clean();
+
+    // If we get here, the write operation was a success
+    return (m_error == error_t::OK);
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// write_delta() - Writes each run of chunks in "map" to the slot at "address", then the header.  Should
+//                 the write be interrupted, the old header (if any) is for an older edition, so read()
+//                 won't pick this slot
+//=========================================================================================================
+bool CEEPROM_Base::write_delta(uint16_t address, uint32_t map)
+{
+    uint16_t chunk = delta_chunk_size();
+
+    for (int first = 0, last; first < DELTA_CHUNKS; first = last)
+    {
+        // Skip over the chunks that don't need writing
+        if ((map & (1UL << first)) == 0)
+        {
+            last = first + 1;
+            continue;
+        }
+
+        // Find the end of this run of chunks
+        for (last = first + 1; last < DELTA_CHUNKS && (map & (1UL << last)); ++last);
+
+        // Convert the run to a range of offsets, clipped to the end of the data
+        uint16_t offset = header_size + first * chunk;
+        uint16_t end    = header_size + last  * chunk;
+        if (offset >= m_data.length) break;
+        if (end > m_data.length) end = m_data.length;
+
+        // And write it
+        if (!write_physical_block(add_ptr(m_data.ptr, offset), address + offset, end - offset)) return false;
+    }
+
+    // The header goes last
+    return write_physical_block(m_data.ptr, address, header_size);
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// prepare_write() - Fills in the header for a new edition of the data, and finds the EEPROM address where
+//                   it should be written
+//=========================================================================================================
+bool CEEPROM_Base::prepare_write(uint16_t* p_address, int* p_slot)
+{
     // Fill in all of the header fields
     m_header.magic = MAGIC_NUMBER;
     m_header.data_len = m_data.length;
@@ -138,26 +243,203 @@ bool CEEPROM_Base::write(bool force_write)
     m_header.crc = compute_crc(m_data.length);
 
     // Find the EEPROM address where this edition should be written
-    if (!find_least_recent_address(&address, &slot))
+    return find_least_recent_address(p_address, p_slot);
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// write_async() - Snapshots the data and starts writing it to EEPROM in the background
+//=========================================================================================================
+bool CEEPROM_Base::write_async(bool force_write)
+{
+    uint16_t address;
+    int      slot;
+
+    // Let the derived class know we're at work
+    api_scope_t scope(this, api_t::WRITE_ASYNC);
+
+    // Without a buffer to hold the snapshot, the best we can do is an ordinary write
+    if (m_async.buffer == nullptr) return write(force_write);
+
+    // There's only ever one background write at a time
+    finish_async();
+
+    // Presume for a moment that this routine is going to succeed
+    m_error = error_t::OK;
+
+    // Ensure that the wear-leveling slots are large enough to hold our data structure!!
+    if (bug_check()) return false;
+
+    // If we're not forcing the write, and the data isn't "dirty", don't commit it to EEPROM
+    if (!force_write && !is_dirty()) return true;
+
+    // Find any changes that were made without going through set()
+    find_changes();
+
+    // Fill in the header and find the EEPROM address where this edition should be written
+    if (!prepare_write(&address, &slot))
     {
         m_error = error_t::IO;
         return false;
     }
 
-    // If we're caching, cache this entry
-    if (m_wl.cache) m_wl.cache[slot] = m_header.edition;
+    // Until the write is committed, this slot doesn't hold a valid edition
+    if (m_wl.cache) m_wl.cache[slot] = EMPTY_SLOT;
+
+    // The write takes care of the chunks this slot is missing.  Changes made from here on get recorded
+    // in the slot's map afresh
+    m_async.map = m_wl.delta ? m_wl.delta[slot] : ALL_CHUNKS;
+    if (m_wl.delta) m_wl.delta[slot] = 0;
+
+    // Take a snapshot of the data.  From here on, the caller is free to change it
+    memcpy(m_async.buffer, m_data.ptr, m_data.length);
+
+    // Erasing a byte of the magic number, the data, the header, and restoring that byte are all steps
+    m_async.address    = address;
+    m_async.slot       = slot;
+    m_async.edition    = m_header.edition;
+    m_async.step       = 0;
+    m_async.step_count = m_data.length + 1;
+
+    // The data structure in RAM now matches what's about to be in EEPROM
+    mark_data_as_clean();
+
+    // If there's an interrupt to drive the write, let it take over
+    enable_ready_interrupt(true);
+    return true;
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// service() - If a background write is in progress and the EEPROM is ready, writes the next byte
+//
+// Returns: true if the background write is still in progress
+//=========================================================================================================
+bool CEEPROM_Base::service()
+{
+    if (is_async_pending() && is_physical_ready()) async_step();
+    return is_async_pending();
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// is_writing() - Returns true while a background write is in progress.  The ISR moves the write along,
+//                and an 8-bit CPU can't read the step counters in one go, so the interrupt is held off
+//                while we look
+//=========================================================================================================
+bool CEEPROM_Base::is_writing()
+{
+    enable_ready_interrupt(false);
+    bool result = is_async_pending();
+    if (result) enable_ready_interrupt(true);
+    return result;
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// async_step() - Writes the next byte of a background write.  A byte of the slot's magic number is erased
+//                first, then the data is written, then the rest of the header, and finally that byte of
+//                the magic number, which commits the new edition.  Data the slot already holds (according
+//                to the delta map) is skipped
+//=========================================================================================================
+void CEEPROM_Base::async_step()
+{
+    uint16_t data_size = m_data.length - header_size;
+    uint16_t chunk = delta_chunk_size();
+    uint16_t step = m_async.step, offset;
+    uint8_t  value;
+
+    // Skip over the chunks of data that don't need writing
+    while (step > 0 && step <= data_size && (m_async.map & (1UL << ((step - 1) / chunk))) == 0) ++step;
+    m_async.step = step;
+
+    // Erase a byte of the magic number
+    if (step == 0)
+    {
+        offset = MAGIC_OFFSET;
+        value  = 0xFF;
+    }
+
+    else
+    {
+        step -= 1;
+
+        // The data
+        if (step < data_size)
+            offset = header_size + step;
+
+        // The header, skipping over the erased byte
+        else if ((step -= data_size) < header_size - 1)
+            offset = (step < MAGIC_OFFSET) ? step : step + 1;
+
+        // And the erased byte
+        else
+            offset = MAGIC_OFFSET;
+
+        value = m_async.buffer[offset];
+    }
+
+    // Write the byte.  If that fails, so does the write
+    if (!write_physical_byte(value, m_async.address + offset))
+    {
+        end_async(false);
+        return;
+    }
+
+    // If that was the last byte, the new edition is committed
+    m_async.step = m_async.step + 1;
+    if (m_async.step == m_async.step_count) end_async(true);
+}
+//=========================================================================================================
 
-    // Write the header and data structure to EEPROM
-    if (!write_physical_block(m_data.ptr, address, m_data.length))
+
+
+//=========================================================================================================
+// end_async() - Wraps up a background write and tells whoever is interested how it went
+//=========================================================================================================
+void CEEPROM_Base::end_async(bool success)
+{
+    // There's no longer a write in progress
+    m_async.step = 0;
+    m_async.step_count = 0;
+    enable_ready_interrupt(false);
+
+    // If the new edition made it, it's now the most recent.  If it didn't, the data is still dirty
+    if (success)
+    {
+        if (m_wl.cache) m_wl.cache[m_async.slot] = m_async.edition;
+    }
+    else
     {
         m_error = error_t::IO;
+        m_is_dirty = true;
+        if (m_wl.delta) m_wl.delta[m_async.slot] = ALL_CHUNKS;
     }
 
-    // The data structure in RAM now matches the data structure in EEPROM
-    mark_data_as_clean();
+    if (m_async.callback) m_async.callback(success);
+}
+//=========================================================================================================
 
-    // If we get here, the write operation was a success
-    return (m_error == error_t::OK);
+
+
+//=========================================================================================================
+// finish_async() - Finishes a background write in progress.  This blocks until it's done
+//=========================================================================================================
+void CEEPROM_Base::finish_async()
+{
+    // The interrupt mustn't write bytes out from under us, or change the step while we look at it
+    enable_ready_interrupt(false);
+
+    // write_physical_byte() waits for the EEPROM to be ready
+    while (is_async_pending()) async_step();
 }
 //=========================================================================================================
 
@@ -171,6 +453,12 @@ bool CEEPROM_Base::roll_back()
     uint16_t address;
     int      slot;
 
+    // Let the derived class know we're at work
+    api_scope_t scope(this, api_t::ROLL_BACK);
+
+    // A background write has to finish before we touch the EEPROM
+    finish_async();
+
     // Presume for a moment that this routine is going to succeed
     m_error = error_t::OK;
 
@@ -200,6 +488,12 @@ bool CEEPROM_Base::roll_back()
 //=========================================================================================================
 bool CEEPROM_Base::destroy()
 {
+    // Let the derived class know we're at work
+    api_scope_t scope(this, api_t::DESTROY);
+
+    // A background write has to finish before we touch the EEPROM
+    finish_async();
+
     // Presume for the moment that this routine is going to succeed
     m_error = error_t::OK;
 
@@ -216,6 +510,9 @@ bool CEEPROM_Base::destroy()
     // The data structure in RAM now matches the data structure in EEPROM
     mark_data_as_clean();
 
+    // The slots' data areas weren't touched, so find out how they differ from RAM
+    build_delta_maps();
+
     // Tell the caller whether this worked
     return (m_error == error_t::OK);
 }
@@ -479,6 +776,111 @@ void CEEPROM_Base::mark_data_as_clean()
 //=========================================================================================================
 
 
+//=========================================================================================================
+// delta_chunk_size() - Returns the number of bytes of data that each bit of a delta map stands for
+//=========================================================================================================
+uint16_t CEEPROM_Base::delta_chunk_size()
+{
+    uint16_t chunk = (m_data.length - header_size + DELTA_CHUNKS - 1) / DELTA_CHUNKS;
+    return chunk ? chunk : 1;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// mark_changed() - Records in every slot's delta map that a range of bytes in the data structure has
+//                  changed.  The header is always written, so changes to it aren't recorded
+//=========================================================================================================
+void CEEPROM_Base::mark_changed(uint16_t offset, uint16_t length)
+{
+    if (m_wl.delta == nullptr || offset + length <= header_size || offset >= m_data.length) return;
+
+    // Clip the range to the data
+    if (offset < header_size)
+    {
+        length -= header_size - offset;
+        offset  = header_size;
+    }
+    if (offset + length > m_data.length) length = m_data.length - offset;
+
+    // Build a mask of the chunks the range touches
+    uint16_t chunk = delta_chunk_size();
+    uint32_t mask = 0;
+    for (uint16_t i = (offset - header_size) / chunk; i <= (offset + length - 1 - header_size) / chunk; ++i)
+    {
+        mask |= 1UL << i;
+    }
+
+    for (int slot = 0; slot < m_wl.count; ++slot) m_wl.delta[slot] |= mask;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// find_changes() - If we're keeping a clean copy of the data, compares the data against it so that
+//                  changes made without going through set() get recorded too
+//=========================================================================================================
+void CEEPROM_Base::find_changes()
+{
+    if (m_wl.delta == nullptr || m_data.clean_copy == nullptr) return;
+
+    uint16_t chunk = delta_chunk_size();
+
+    for (uint16_t offset = header_size; offset < m_data.length; offset += chunk)
+    {
+        uint16_t length = m_data.length - offset;
+        if (length > chunk) length = chunk;
+
+        if (memcmp(add_ptr(m_data.ptr, offset), add_ptr(m_data.clean_copy, offset), length) != 0)
+        {
+            mark_changed(offset, length);
+        }
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// build_delta_maps() - Compares the data area of every slot in EEPROM against the data in RAM, and
+//                      records which chunks differ.  A slot we can't read is presumed to differ entirely
+//=========================================================================================================
+void CEEPROM_Base::build_delta_maps()
+{
+    uint8_t  buffer[16];
+
+    if (m_wl.delta == nullptr) return;
+
+    uint16_t chunk = delta_chunk_size();
+
+    for (int slot = 0; slot < m_wl.count; ++slot)
+    {
+        uint16_t address = slot_to_header_address(slot);
+        uint32_t& map = m_wl.delta[slot];
+        map = 0;
+
+        // Compare the slot a buffer-full at a time
+        for (uint16_t offset = header_size; offset < m_data.length; offset += sizeof buffer)
+        {
+            uint16_t length = m_data.length - offset;
+            if (length > sizeof buffer) length = sizeof buffer;
+
+            if (!read_physical_block(buffer, address + offset, length))
+            {
+                map = ALL_CHUNKS;
+                break;
+            }
+
+            const uint8_t* ram = (const uint8_t*)add_ptr(m_data.ptr, offset);
+            for (uint16_t i = 0; i < length; ++i)
+            {
+                if (buffer[i] != ram[i]) map |= 1UL << ((offset + i - header_size) / chunk);
+            }
+        }
+    }
+}
+//=========================================================================================================
+
+
 //=========================================================================================================
 // is_dirty() - Determines whether the data structure in RAM is "dirty" (i.e., is it different than what
 //              is currently in EEPROM?)
@@ -13,6 +13,8 @@
 //     The ability to "roll-back" a write, as though the write never happened
 //     Seamless management of new EEPROM formats
 //     Manages storage devices of up to 64K
+//     Optional background writes, so the main loop keeps running while the data is saved
+//     Optional delta writes, which only write the parts of the data that have changed
 // 
 // -------------------------
 // BASIC USAGE OF THIS CLASS
@@ -153,6 +155,48 @@
 //         // Used to read a block of data from EEPROM
 //         virtual bool read_physical_block(void* dest, uint16_t address, uint16_t length);
 //
+// -----------------
+// BACKGROUND WRITES
+// -----------------
+//
+//     write_async() snapshots the data structure and returns right away.  The snapshot is then written a
+//     byte at a time by service(), which is called either from loop() or from an interrupt that fires
+//     whenever the EEPROM is ready for another byte.  To use background writes, your constructor must
+//     point "m_async.buffer" at a buffer as large as your data structure.  To have them driven by an
+//     interrupt, override enable_ready_interrupt() and call service() from the ISR.
+//
+//     A byte of the slot's magic number is erased first and written last, so an interrupted write leaves
+//     nothing that read() will mistake for valid data.  That costs 2 extra bytes of programming per write.
+//
+//     Your derived class can override these to write a byte without waiting for the EEPROM to finish
+//     the previous one.  By default they fall back on write_physical_block():
+//
+//         // Returns true when the EEPROM can accept another byte
+//         virtual bool is_physical_ready();
+//
+//         // Starts writing a byte to EEPROM
+//         virtual bool write_physical_byte(uint8_t value, uint16_t address);
+//
+// ------------
+// DELTA WRITES
+// ------------
+//
+//     If your constructor points "m_wl.delta" at an array of uint32_t (one per wear-leveling slot), each
+//     entry is a map of which parts of the data differ between that slot and RAM.  The data (not counting
+//     the header) is divided into 32 chunks, one bit apiece.  A write then only writes the chunks that
+//     the slot doesn't already hold, followed by the header.
+//
+//     The maps are built by read() from what's actually in each slot, and kept up to date by set() and,
+//     if you have dirty checking, by comparing the data to the clean copy.  Without a clean copy, every
+//     change to the data must go through set().
+//
+// -----------------
+// TIMING API CALLS
+// -----------------
+//
+//     A derived class can override on_api() to find out when each public API call starts and finishes,
+//     for instance to measure how long a write() blocks.  The default does nothing.
+//
 // ----------
 // CHANGE LOG
 // ----------
@@ -172,6 +216,9 @@ public:
     // These are the types of errors that can occur
     enum class error_t : char { OK, IO, CRC, BUG };
 
+    // These are the public API calls, as reported to on_api()
+    enum class api_t : char { READ, WRITE, ROLL_BACK, DESTROY, WRITE_ASYNC };
+
     // Constructor.
     // *** Derived constructors MUST FILL IN THE m_data DATA DESCRIPTOR *****
     CEEPROM_Base();
@@ -186,6 +233,20 @@ public:
     // physical write to occur even if dirty-checking is on and the data isn't dirty
     bool    write(bool force = false);
 
+    // Starts writing the data structure to EEPROM in the background, and returns right away.  If a
+    // background write is already in progress, it is finished first
+    bool    write_async(bool force = false);
+
+    // Moves a background write along by a byte, if the EEPROM is ready for one.  Call this from loop()
+    // or from the "EEPROM ready" interrupt.  Returns true while the write is still in progress
+    bool    service();
+
+    // Returns true while a background write is in progress
+    bool    is_writing();
+
+    // Registers a function to be called (possibly from an ISR) when a background write finishes
+    void    on_write_complete(void (*callback)(bool success)) { m_async.callback = callback; }
+
     // Restore the EEPROM and data structure to where it was before the most recent "write()"
     bool    roll_back();
 
@@ -205,6 +266,26 @@ protected:
     virtual bool write_physical_block(void* src,  uint16_t address, uint16_t length) = 0;
     virtual bool read_physical_block (void* dest, uint16_t address, uint16_t length) = 0;
 
+    // Byte-at-a-time physical I/O for background writes.  The defaults fall back on the block routines
+    virtual bool is_physical_ready() { return true; }
+    virtual bool write_physical_byte(uint8_t value, uint16_t address) { return write_physical_block(&value, address, 1); }
+
+    // Override this to enable or disable an interrupt that calls service() whenever the EEPROM is ready
+    // for another byte.  Without one, the caller must call service() from loop()
+    virtual void enable_ready_interrupt(bool) {}
+
+    // Called when a public API call starts, and again when it finishes
+    virtual void on_api(api_t, bool) {}
+
+    // Reports the start of an API call when it's constructed, and the finish when it goes out of scope
+    struct api_scope_t
+    {
+        api_scope_t(CEEPROM_Base* owner, api_t api) : owner(owner), api(api) { owner->on_api(api, false); }
+        ~api_scope_t() { owner->on_api(api, true); }
+        CEEPROM_Base* owner;
+        api_t         api;
+    };
+
     //-----------------------------------------------------------------------
     // The order of these fields must not be disturbed!  
     //
@@ -223,8 +304,20 @@ protected:
     // Data descriptor - describes the user's data structure
     struct { void* ptr; uint16_t length; uint16_t format; void* clean_copy; } m_data;
 
-    // Wear leveling configuration
-    struct { uint16_t count; uint16_t size; uint32_t* cache; } m_wl;
+    // Wear leveling configuration, with an optional delta map per slot
+    struct { uint16_t count; uint16_t size; uint32_t* cache; uint32_t* delta; } m_wl;
+
+    // A background write: the snapshot being written, where it's going, and how far along it is
+    struct
+    {
+        uint8_t*  buffer;
+        uint16_t  address;
+        int       slot;
+        uint32_t  edition;
+        uint32_t  map;
+        volatile uint16_t step, step_count;
+        void      (*callback)(bool success);
+    } m_async;
     
     // This is the error code set by one of our public API calls
     error_t     m_error;
@@ -268,14 +361,38 @@ protected:
     // Reads a header from EEPROM into RAM
     bool        read_header(header_t* p_result, uint16_t address);
 
+    // Fills in the header for a new edition and finds the slot it should be written to
+    bool        prepare_write(uint16_t* p_address, int* p_slot);
+
+    // Writes the next byte of a background write, then ends the write if that was the last one
+    void        async_step();
+    void        end_async(bool success);
+
+    // Finishes any background write in progress before the caller touches the EEPROM
+    void        finish_async();
+
+    // True while a background write is in progress.  Only safe to call where the ISR can't run
+    bool        is_async_pending() { return m_async.step < m_async.step_count; }
+
+    // Delta maps: how many bytes a chunk holds, recording a change to the data, finding the changes made
+    // behind our back, and building the maps from what's in EEPROM
+    uint16_t    delta_chunk_size();
+    void        mark_changed(uint16_t offset, uint16_t length);
+    void        find_changes();
+    void        build_delta_maps();
+
+    // Writes the chunks of the data in "map" to a slot, then the header
+    bool        write_delta(uint16_t address, uint32_t map);
+
     // A convenience constant
-    const int header_size = sizeof(header_t);
+    enum { header_size = sizeof(header_t) };
 
     // A convenient method for setting data values when the data structure is declared "const"
     template <class T> void set(const T& dest, T value)
     {
         *(T*)&dest = value;
         m_is_dirty = true;
+        mark_changed((uint16_t)((const char*)&dest - (const char*)m_data.ptr), sizeof(T));
     }
 
 
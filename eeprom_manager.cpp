@@ -1,6 +1,22 @@
 #include <avr/eeprom.h>
 #include <string.h>
+#include <Arduino.h>
 #include "eeprom_manager.h"
+#include "globals.h"
+
+// The AVR routines don't return a status.  In the simulator, an injected fault can make them fail
+#ifdef __AVR__
+#define eeprom_status() true
+#else
+#define eeprom_status() sim_eeprom_status()
+#endif
+
+
+//=========================================================================================================
+// The "EEPROM ready" interrupt drives background writes, a byte at a time
+//=========================================================================================================
+ISR(EE_READY_vect) { EEPROM.service(); }
+//=========================================================================================================
 
 
 //=========================================================================================================
@@ -29,6 +45,14 @@ void CEEPROM::initialize_new_fields()
           (etc)
       }
 */
+
+    // The PID constants were added in DATA_FORMAT #2.  Everything else added there defaults to zero
+    if (data.header.format < 2)
+    {
+        data.kp = 1.0f;
+        data.ki = 0.0f;
+        data.kd = 0.0f;
+    }
 }
 //=========================================================================================================
 
@@ -42,8 +66,42 @@ CEEPROM::CEEPROM() : CEEPROM_Base()
     // Fill in the data descriptor, including automatic dirty-checking
     m_data = { &data, sizeof(data), DATA_FORMAT, &clean };
 
-    // Fill in the wear-leveling configuration, including journal caching
-    m_wl = { WEAR_LEVELING_SLOTS, WEAR_LEVELING_SIZE, m_cache_buffer };
+    // Fill in the wear-leveling configuration, including journal caching and delta writes.  Until read()
+    // looks at the slots, presume that every part of every slot differs
+    m_wl = { WEAR_LEVELING_SLOTS, WEAR_LEVELING_SIZE, m_cache_buffer, m_delta_buffer };
+    memset(m_delta_buffer, 0xFF, sizeof(m_delta_buffer));
+
+    // This is where background writes keep their snapshot of the data
+    m_async.buffer = m_async_buffer;
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// operator=() - Copies the state of another CEEPROM.  The base class copies the flags (and descriptors
+//               that point into "rhs"), so we copy the buffers by hand and point the descriptors back
+//               at our own buffers
+//=========================================================================================================
+CEEPROM& CEEPROM::operator=(const CEEPROM& rhs)
+{
+    // Copy the flags and error status
+    CEEPROM_Base::operator=(rhs);
+
+    // Copy the data structures.  They have a const header, so they can't simply be assigned
+    memcpy((void*)&data,  &rhs.data,  sizeof(data));
+    memcpy((void*)&clean, &rhs.clean, sizeof(clean));
+    memcpy(m_cache_buffer, rhs.m_cache_buffer, sizeof(m_cache_buffer));
+    memcpy(m_async_buffer, rhs.m_async_buffer, sizeof(m_async_buffer));
+    memcpy(m_delta_buffer, rhs.m_delta_buffer, sizeof(m_delta_buffer));
+
+    // And point the descriptors at our own copies
+    m_data.ptr        = &data;
+    m_data.clean_copy = &clean;
+    m_wl.cache        = m_cache_buffer;
+    m_wl.delta        = m_delta_buffer;
+    m_async.buffer    = m_async_buffer;
+    return *this;
 }
 //=========================================================================================================
 
@@ -59,8 +117,8 @@ bool CEEPROM::write_physical_block(void* src, uint16_t address, uint16_t length)
     // Use the AVR API to write the block from RAM into EEPROM
     eeprom_update_block(src, (void*)(address), length);
 
-    // The AVR routines don't return a status, so we have to just assume they worked
-    return true;
+    // On the real hardware, we have to just assume this worked
+    return eeprom_status();
 };
 //=========================================================================================================
 
@@ -74,8 +132,56 @@ bool CEEPROM::read_physical_block(void* dest, uint16_t address, uint16_t length)
     // Use the AVR API to read the block from EEPROM into RAM
     eeprom_read_block(dest, (void*)(address), length);
 
-    // The AVR routines don't return a status, so we have to just assume they worked
-    return true;
+    // On the real hardware, we have to just assume this worked
+    return eeprom_status();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// is_physical_ready() - Returns true when the EEPROM has finished programming the previous byte
+//=========================================================================================================
+bool CEEPROM::is_physical_ready()
+{
+    return eeprom_is_ready();
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// write_physical_byte() - Starts programming a byte.  The EEPROM carries on by itself while we return
+//=========================================================================================================
+bool CEEPROM::write_physical_byte(uint8_t value, uint16_t address)
+{
+    eeprom_update_byte((uint8_t*)(uintptr_t)(address), value);
+    return eeprom_status();
+}
+//=========================================================================================================
+
+
+
+//=========================================================================================================
+// enable_ready_interrupt() - Turns the "EEPROM ready" interrupt on or off
+//=========================================================================================================
+void CEEPROM::enable_ready_interrupt(bool flag)
+{
+    if (flag)
+        EECR |= (1 << EERIE);
+    else
+        EECR &= ~(1 << EERIE);
+}
+//=========================================================================================================
+
+
+#ifndef __AVR__
+//=========================================================================================================
+// on_api() - Hands the start and finish of each API call to the simulator, which times them
+//=========================================================================================================
+void CEEPROM::on_api(api_t api, bool is_finished)
+{
+    sim_eeprom_api((int)api, is_finished);
 }
 //=========================================================================================================
+#endif
 
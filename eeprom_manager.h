@@ -43,10 +43,14 @@ public:
     // Constructor. 
     CEEPROM();
 
+    // Copying a CEEPROM copies its data.  The copy's descriptors still point at its own buffers
+    CEEPROM(const CEEPROM& rhs) : CEEPROM() { *this = rhs; }
+    CEEPROM& operator=(const CEEPROM& rhs);
+
     // **********************************************************************************
     // *** ABSOLUTELY ANY TIME THE DATA STRUCTURE CHANGES, THIS MUST BE INCREMENTED!! ***
     // **********************************************************************************
-    enum {DATA_FORMAT = 1};
+    enum {DATA_FORMAT = 2};
 
 
     // **********************************************************************************
@@ -59,6 +63,13 @@ public:
     {
         const header_t  header = { 0 };
         uint8_t         run_mode;
+
+        // Added in DATA_FORMAT 2
+        uint8_t         manual_index;
+        int16_t         setpoint;
+        uint8_t         orientation;
+        uint8_t         is_servo_calibrated;
+        float           kp, ki, kd;
     } data, clean;
         
 
@@ -74,11 +85,27 @@ protected:
     bool write_physical_block(void* src, uint16_t address, uint16_t length);
     bool read_physical_block(void* dest, uint16_t address, uint16_t length);
 
+    // Background writes are driven a byte at a time by the "EEPROM ready" interrupt
+    bool is_physical_ready();
+    bool write_physical_byte(uint8_t value, uint16_t address);
+    void enable_ready_interrupt(bool flag);
+
+    // In the simulator, this reports each API call so that its cost can be measured
+#ifndef __AVR__
+    void on_api(api_t api, bool is_finished);
+#endif
+
     // Since we're doing wear leveling, we need to define these.  We're going to use
     // the optional journal caching, so we declare a cache buffer
     enum { WEAR_LEVELING_SLOTS = 4 };
     enum { WEAR_LEVELING_SIZE  = 0x400};
     uint32_t m_cache_buffer[WEAR_LEVELING_SLOTS];
+
+    // Which parts of each slot differ from the data, so that a write only sends the changes
+    uint32_t m_delta_buffer[WEAR_LEVELING_SLOTS];
+
+    // A background write takes a snapshot of the data structure here
+    uint8_t  m_async_buffer[sizeof(data_t)];
 };
 
 
@@ -2,7 +2,7 @@
 // fast_sht31.cpp - Implements an efficient class for reading the SHT31 temperature/humidity sensor
 //=========================================================================================================
 #include "fast_sht31.h"
-#include "arduino.h"
+#include "Arduino.h"
 #include <utility/twi.h>
 
 //=========================================================================================================
@@ -61,8 +61,8 @@ uint8_t fast_crc8(const uint8_t* in, uint8_t count)
 //=========================================================================================================
 static float raw_to_c(uint32_t raw_temp)
 {
-    // Compute the temperature in 100ths of a degree C
-    uint16_t hundreths = ((17500 * raw_temp) >> 16) - 4500;
+    // Compute the temperature in 100ths of a degree C.  This is signed: it's negative below 0 C
+    int16_t hundreths = ((17500 * raw_temp) >> 16) - 4500;
 
     // Return the temperature in degrees C
     return hundreths * .01F;
@@ -90,8 +90,8 @@ static float raw_to_c(uint32_t raw_temp)
 //=========================================================================================================
 static float raw_to_f(uint32_t raw_temp)
 {
-    // Compute the temperature in 100ths of a degree F
-    uint16_t hundreths = ((31500 * raw_temp) >> 16) - 4900;
+    // Compute the temperature in 100ths of a degree F.  This is signed: it's negative below 0 F
+    int16_t hundreths = ((31500 * raw_temp) >> 16) - 4900;
 
     // Return the temperature in degrees F
     return hundreths * .01F;
@@ -1,5 +1,27 @@
 #include "globals.h"
+#ifdef __AVR__
+#include <avr/wdt.h>
+#endif
 
+// In the simulator, these live in each simulated device (see sim_device.h)
+#ifdef __AVR__
 CRotaryKnob Knob;
 
 CSleepMgr SleepMgr;
+
+CSystem System;
+
+CEEPROM EEPROM;
+
+IS31FL3731<LED_GEOMETRY, LED_CHIPS> Display;
+
+//=========================================================================================================
+// reboot() - Lets the watchdog timer reset the chip
+//=========================================================================================================
+void CSystem::reboot()
+{
+    wdt_enable(WDTO_15MS);
+    while (true);
+}
+//=========================================================================================================
+#endif
@@ -1,8 +1,7 @@
 #pragma once
 
 #include "rotary_knob.h"
-
-extern CRotaryKnob Knob;
+#include "common.h"
 
 
 class CSleepMgr
@@ -12,5 +11,20 @@ public:
     void on_knob_activity() {};
 };
 
+class CSystem
+{
+public:
+    void reboot();
+};
 
+#ifdef __AVR__
+#include "eeprom_manager.h"
+#include "is31fl3731.h"
+extern CRotaryKnob Knob;
 extern CSleepMgr SleepMgr;
+extern CSystem System;
+extern CEEPROM EEPROM;
+extern IS31FL3731<LED_GEOMETRY, LED_CHIPS> Display;
+#else
+#include "sim_device.h"     // In the simulator, every device has its own copy of these
+#endif
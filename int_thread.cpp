@@ -1,105 +1,113 @@
 #include "int_thread.h"
-#include <Windows.h>
+#ifdef __linux__
+#include <unistd.h>
+#else
 #include <conio.h>
-#include "arduino.h"
+#endif
+#include "Arduino.h"
 #include "common.h"
 #include "rotary_knob.h"
 #include "globals.h"
+#include "sim_device.h"
+#include "sim_host.h"
 
 
-void knob_rotate_isr();
-void PCINT1_vect();
-void INT1_vect();
-
-static void click_interrupt(int state)
+//===========================================================================================================
+// throw_away_next_event() - Runs on the simulation thread to tell the knob to ignore its next event
+//===========================================================================================================
+static void throw_away_next_event(const char*)
 {
-    sim_input(CLICK_PIN, state);
-    PCINT1_vect();
+    Knob.throw_away_next_event();
 }
+//===========================================================================================================
 
-#ifdef OLDINT
-static void turn_interrupt(knob_event_t state)
-{
-    int b_state = (state == KNOB_LEFT) ? 1 : 0;
-
-    sim_input(CHANNEL_A, 0);
-    sim_input(CHANNEL_B, b_state);
-    knob_rotate_isr();
-    Sleep(1);
-    sim_input(CHANNEL_A, 1);
-    knob_rotate_isr();
-}
-#else
-static void turn_interrupt(knob_event_t state)
+
+//===========================================================================================================
+// on_key() - Converts a keystroke into stimulus for the device
+//===========================================================================================================
+void InterruptThread::on_key(int c)
 {
-    int b_state = (state == KNOB_LEFT) ? 1 : 0;
+    CSimStimulus::batch_t batch;
+
+    // Convert to uppercase
+    if (c >= 'a' && c <= 'z') c -= 32;
+
+    switch (c)
+    {
+    case 'D':
+        CSimStimulus::add_button(batch, 0, 0);
+        break;
+
+    case 'U':
+        CSimStimulus::add_button(batch, 0, 1);
+        break;
+
+    case 'L':
+        CSimStimulus::add_turn(batch, 0, KNOB_LEFT);
+        CSimStimulus::add_turn(batch, 0, KNOB_RIGHT);
+        CSimStimulus::add_turn(batch, 0, KNOB_LEFT);
+        break;
+
+    case 'R':
+        CSimStimulus::add_turn(batch, 0, KNOB_RIGHT);
+        CSimStimulus::add_turn(batch, 0, KNOB_LEFT);
+        CSimStimulus::add_turn(batch, 0, KNOB_RIGHT);
+        break;
+
+    case 'T':
+        batch.push_back(CSimScheduler::call_event(0, throw_away_next_event));
+        break;
+
+    }
 
-    sim_input(CHANNEL_B, b_state);
-    INT1_vect();
+    // Hand the stimulus to the scheduler, which will fire it on the simulation thread
+    if (!batch.empty()) m_device->scheduler.post(batch);
 }
+//===========================================================================================================
 
 
+//===========================================================================================================
+// main() - Waits for keystrokes and simulates interrupts
+//===========================================================================================================
+void InterruptThread::main()
+{
+#ifndef __linux__
+    while (true) on_key(_getch());
 #endif
+}
+//===========================================================================================================
 
 
+#ifdef __linux__
 //===========================================================================================================
-// main() - Waits for messages and simulates interrupts
+// on_stdin() - The host loop calls this when there are keystrokes waiting
 //===========================================================================================================
-void InterruptThread::main()
+static void on_stdin(int fd, void* context)
 {
-    while (true)
-    {
-        // Fetch a character and convert to uppercase
-        int c = _getch();
-        if (c >= 'a' && c <= 'z') c -= 32;
-
-        switch (c)
-        {
-        case 'D':
-            click_interrupt(0);
-            Sleep(8);
-            click_interrupt(1);
-            Sleep(8);
-            click_interrupt(0);
-            break;
-
-        case 'U':
-            click_interrupt(1);
-            Sleep(8);
-            click_interrupt(0);
-            Sleep(8);
-            click_interrupt(1);
-            break;
-
-        case 'L':
-            turn_interrupt(KNOB_LEFT);
-            turn_interrupt(KNOB_RIGHT);
-            turn_interrupt(KNOB_LEFT);
-            break;
-
-        case 'R':
-            turn_interrupt(KNOB_RIGHT);
-            turn_interrupt(KNOB_LEFT);
-            turn_interrupt(KNOB_RIGHT);
-            break;
-
-        case 'T':
-            Knob.throw_away_next_event();
-            break;
-
-        }
+    InterruptThread* p_object = (InterruptThread*)context;
+    char buffer[64];
 
+    // Fetch whatever keystrokes are waiting
+    ssize_t count = read(fd, buffer, sizeof buffer);
 
+    // If stdin has been closed, there will never be any more keystrokes
+    if (count <= 0)
+    {
+        SimHost.remove_fd(fd);
+        return;
     }
+
+    // Simulate the stimulus for each keystroke
+    for (ssize_t i = 0; i < count; ++i) p_object->on_key(buffer[i]);
 }
 //===========================================================================================================
-
+#endif
 
 
 //=========================================================================================================
 // launch_cthread() - This is a helper function responsible for actually bringing the thread into existence.
 //=========================================================================================================
-static unsigned int launch_cthread(void* pointer)
+unsigned int launch_cthread(void* pointer)
 {
     // Get a pointer to our ComputeThread object
     InterruptThread* p_object = (InterruptThread*)pointer;
@@ -116,14 +124,22 @@ static unsigned int launch_cthread(void* pointer)
 //=========================================================================================================
 // spawn() - Spawns the thread
 //=========================================================================================================
-void InterruptThread::spawn()
+void InterruptThread::spawn(CSimDevice* device)
 {
+    // Save the device we're sending stimulus to
+    m_device = device;
 
+#ifdef __linux__
+    // On Linux there's no need for a thread: the keyboard is just one more input to the host loop
+    SimHost.raw_console();
+    SimHost.add_fd(STDIN_FILENO, on_stdin, this);
+#else
     // Spawn this thread
     auto new_thread = std::thread(launch_cthread, this);
 
     // And let it run freely, detached from the scope of the variable "new_thread"
     new_thread.detach();
+#endif
 }
 //=========================================================================================================
 
@@ -1,13 +1,18 @@
 #pragma once
 #include <thread>
 
+class CSimDevice;
+
 
 class InterruptThread
 {
 public:
 
-    // Spawns the thread
-    void    spawn();
+    // Spawns the thread.  Keystrokes become stimulus for the given device
+    void    spawn(CSimDevice* device);
+
+    // Converts a keystroke into stimulus
+    void    on_key(int c);
 
 protected:
 
@@ -16,5 +21,8 @@ protected:
 
     // This is to allow the external "launch_thread()" function access to "main()"
     friend unsigned int launch_cthread(void*);
+
+    // The device we're sending stimulus to
+    CSimDevice* m_device;
 };
 
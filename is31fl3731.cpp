@@ -1,16 +1,18 @@
 //=============================================================================================
-// is31fl3731.cpp - Implents a two-character display driver for the IS31FL3731 Led Matrix
+// is31fl3731.cpp - Implements a text display driver for IS31FL3731 LED matrix boards
 //=============================================================================================
 #include <string.h>
+#include <stdio.h>
 #include "is31fl3731.h"
 #include <Wire.h>
-#include <arduino.h>
+#include <Arduino.h>
 
-#define FRAME_SELECT_REG  0xFD
-#define CONFIG_FRAME      0x0B
-#define PWM_BASE_REG      0x24
-#define LED_CTRL_BASE_REG 0x00
-#define SHUTDOWN_REG      0x0A
+// In the simulator, a pending upload tells the virtual clock that the main loop has work to do
+#ifdef __AVR__
+#define note_busy()
+#else
+#define note_busy() sim_busy()
+#endif
 
 const unsigned char font[] PROGMEM = 
 {
@@ -272,125 +274,164 @@ const unsigned char font[] PROGMEM =
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00       // ASCII 255
 };
 
+
 //=============================================================================================
-// Lookup table that maps an LED index to a PWM register.  This table was built with the 
-// code below it
+// Constructor() - Records the geometry.  Nothing touches the hardware until init()
 //=============================================================================================
-static const unsigned char pwm_reg[] PROGMEM = 
+IS31FL3731_Base::IS31FL3731_Base(int cols, int rows, const uint8_t* led_map, int chip_count)
 {
-    43, 59, 75, 91, 107, 123, 139, 155, 156, 140, 124, 108, 92, 76, 60, 44,
-    42, 58, 74, 90, 106, 122, 138, 154, 157, 141, 125, 109, 93, 77, 61, 45,
-    41, 57, 73, 89, 105, 121, 137, 153, 158, 142, 126, 110, 94, 78, 62, 46,
-    40, 56, 72, 88, 104, 120, 136, 152, 159, 143, 127, 111, 95, 79, 63, 47,
-    39, 55, 71, 87, 103, 119, 135, 151, 160, 144, 128, 112, 96, 80, 64, 48,
-    38, 54, 70, 86, 102, 118, 134, 150, 161, 145, 129, 113, 97, 81, 65, 49,
-    37, 53, 69, 85, 101, 117, 133, 149, 162, 146, 130, 114, 98, 82, 66, 50,
-    36, 52, 68, 84, 100, 116, 132, 148, 163, 147, 131, 115, 99, 83, 67, 51,
-};
+    m_cols       = cols;
+    m_rows       = rows;
+    m_led_map    = led_map;
+    m_chip_count = chip_count;
+    m_stride     = (cols * chip_count + 7) / 8;
+
+    // Text sits in the vertical middle of the display
+    m_text_row   = (rows - CHAR_ROWS) / 2;
+
+    m_brightness = 255;
+    m_orientation = true;
+    m_is_binary = false;
+    m_is_upload_pending = false;
+    m_is_background = false;
+    m_marquee[0] = 0;
+}
 //=============================================================================================
-/* 
-static void IS31FL3731::map_led_to_pwm_reg()
+
+
+//=============================================================================================
+// set_pixel() - Turns an LED of the framebuffer on or off
+//=============================================================================================
+void IS31FL3731_Base::set_pixel(int row, int col, bool on)
 {
-    int row, col;
-    int starting_reg_l = MAX_ROWS - 1;
-    int starting_reg_r = MAX_ROWS + 16*7;
-    int index = 0;
-    
-    // Loop through every row the chip supports
-    for (row = 0; row < MAX_ROWS; ++row)
-    {
-        // For the first 8 columns, register numbers are ascending
-        for (col=0; col< MAX_COLS/2; ++col)
-        {
-            pwm_reg[index++] = PWM_BASE_REG + starting_reg_l + col*16;  
-        }
+    if (row < 0 || row >= m_rows || col < 0 || col >= width()) return;
 
-        // For the next 8 columns, register numbers are descending
-        for (col=0; col<MAX_COLS/2; ++col)
-        {
-            pwm_reg[index++] = PWM_BASE_REG + starting_reg_r - col*16;
-        }
+    uint8_t* p = framebuffer() + row * m_stride + col / 8;
+    uint8_t mask = 0x80 >> (col % 8);
 
-        --starting_reg_l;
-        ++starting_reg_r;
-    }
+    if (on)
+        *p |= mask;
+    else
+        *p &= ~mask;
 }
 //=============================================================================================
-*/
+
 
 //=============================================================================================
-// transmit() - Transmits data to the device via I2C
+// get_pixel() - Returns true if an LED of the framebuffer is on
 //=============================================================================================
-void IS31FL3731::transmit(const uint8_t* data, size_t length)
+bool IS31FL3731_Base::get_pixel(int row, int col)
 {
-    Wire.flush();
-    Wire.beginTransmission(m_i2c_address);
-    Wire.write(data, length);
-    Wire.endTransmission();
+    return (framebuffer()[row * m_stride + col / 8] & (0x80 >> (col % 8))) != 0;
 }
 //=============================================================================================
 
 
 //=============================================================================================
-// write_reg() - Writes an 8-bit value to an 8-bit address on the device
+// build_image() - Builds each chip's register image from the framebuffer
 //=============================================================================================
-void IS31FL3731::write_reg(unsigned char address, unsigned char value)
+void IS31FL3731_Base::build_image()
 {
-    unsigned char buffer[2] = { address, value };
-    transmit(buffer, 2);
+    const int right_col = width() - 1;
+    const int bottom_row = m_rows - 1;
+
+    for (int index = 0; index < m_chip_count; ++index)
+    {
+        IS31FL3731_Chip& this_chip = chip(index);
+
+        // Every LED starts out dark
+        this_chip.begin_image(m_is_binary, m_brightness);
+
+        // The LED map is row by row, for one board
+        const uint8_t* map = m_led_map;
+
+        for (int row = 0; row < m_rows; ++row)
+        {
+            for (int col = 0; col < m_cols; ++col)
+            {
+                // Find out which LED this is on the chip
+                int led = pgm_read_byte_near(map++);
+
+                // Where does this LED fall in the framebuffer?  Upside down, everything is
+                // rotated by 180 degrees
+                int fb_row = row;
+                int fb_col = index * m_cols + col;
+                if (!m_orientation)
+                {
+                    fb_row = bottom_row - fb_row;
+                    fb_col = right_col - fb_col;
+                }
+
+                // If it's on in the framebuffer, light it
+                if (get_pixel(fb_row, fb_col)) this_chip.set_led(led);
+            }
+        }
+    }
 }
 //=============================================================================================
 
 
 
 //=============================================================================================
-// display_image() - Transmits the PWM values for our entire bitmap to the device
+// display_image() - Builds each chip's image from the framebuffer and sends it to the device
 //=============================================================================================
-void IS31FL3731::display_image()
+void IS31FL3731_Base::display_image()
 {
-    // This holds the address of a PWM register plus 1 PWM value
-    unsigned char cmd[2];
+    build_image();
 
-    // Find out how many columns of LEDs are missing from the right-edge
-    const int missing_led_cols = MAX_COLS - PHYS_COLS;
+    // Start the upload to each chip's back frame
+    for (int index = 0; index < m_chip_count; ++index) chip(index).start_upload();
+    m_is_upload_pending = true;
 
-    // Create a bitmask with a 1 in either the left-most or right-most bit 
-    // that corresponds to a physical LED
-    uint16_t initial_mask = (m_orientation) ? (1 << 15) : (1 << missing_led_cols);
+    // Unless the main loop is doing it for us in the background, run the upload to completion
+    // right now
+    if (!m_is_background) while (upload());
+}
+//=============================================================================================
 
-    // Loop through each row of the display from top to bottom
-    for (int row = 0; row < PHYS_ROWS; ++row)
-    {
-        // Find the index of the first LED in this row
-        int led_index = row * MAX_COLS;
 
-        // Fetch the LED-is-on bits for the bitmap-row we care about
-        uint16_t row_bits = (m_orientation) ? m_bitmap[row] : m_bitmap[PHYS_ROWS - 1 - row];
 
-        // The mask for this row starts with a 1 in either the left-most or right-most bit
-        // that coreresponds to a physical LED
-        uint16_t mask = initial_mask;
+//=============================================================================================
+// service() - Scrolls the marquee when it's due, and moves any pending image one step closer
+//             to being displayed
+//
+// Returns: true while an image is still on its way to the device
+//=============================================================================================
+bool IS31FL3731_Base::service()
+{
+    if (m_marquee_timer.is_expired()) marquee_step();
+    return upload();
+}
+//=============================================================================================
+
 
-        // Loop through each column, turning a bit into a PWM value
-        for (int col = 0; col < PHYS_COLS; ++col)
+
+//=============================================================================================
+// upload() - Moves the pending image one step closer to being displayed.  Each call sends
+//            one run of registers to one chip.  Once every chip's back frame is complete,
+//            they all flip to their new image, one after another with no uploads between
+//
+// Returns: true if there's more work to do
+//=============================================================================================
+bool IS31FL3731_Base::upload()
+{
+    // If there's no image waiting to be displayed, there's nothing to do
+    if (!m_is_upload_pending) return false;
+
+    // If any chip has more to send, send it
+    for (int index = 0; index < m_chip_count; ++index)
+    {
+        if (chip(index).upload())
         {
-            // Find out which PWM register corresponds to this LED
-            cmd[0] = pgm_read_byte_near(pwm_reg + led_index++);
-
-            // Determine whether we're turning this LED on or off
-            cmd[1] = (row_bits & mask) ? m_brightness : 0;
-            
-            // Transmit the PWM value to the register
-            transmit(cmd, 2);
-
-            // And shift to the next (or previous) LED
-            if (m_orientation)
-                mask >>= 1;
-            else
-                mask <<= 1;
+            note_busy();
+            return true;
         }
-
     }
+
+    // Every back frame is complete: make them the visible frames
+    for (int index = 0; index < m_chip_count; ++index) chip(index).flip();
+    m_is_upload_pending = false;
+    return false;
 }
 //=============================================================================================
 
@@ -399,49 +440,34 @@ void IS31FL3731::display_image()
 //=============================================================================================
 // init() - Call once at startup
 //=============================================================================================
-void IS31FL3731::init(int i2c_address, unsigned char brightness)
+void IS31FL3731_Base::init(int i2c_address, unsigned char brightness)
 {
-    // Save the I2C address for future use
-    m_i2c_address = i2c_address;
-
     // Save the PWM value we want to use to turn an LED on
     m_brightness = brightness;
 
     // We start out in right-side-up orientation
     m_orientation = true;
 
-    // Clear the bitmap.  This is the equivalent of a "clear the screen"
-    memset(m_bitmap, 0, sizeof m_bitmap);
+    // We start out with a PWM value per LED
+    m_is_binary = false;
+
+    // Until told otherwise, images are uploaded as soon as they're drawn
+    m_is_upload_pending = false;
+    m_is_background = false;
+
+    // Clear the framebuffer.  This is the equivalent of a "clear the screen"
+    memset(framebuffer(), 0, m_rows * m_stride);
+    m_marquee_timer.stop();
 
     // Ensure that the Wire library is running
     Wire.begin();
     Wire.setClock(400000);
 
-    // Select frame #9, which is actually the control registers
-    write_reg(FRAME_SELECT_REG, CONFIG_FRAME);
+    // Initialize each chip
+    for (int index = 0; index < m_chip_count; ++index) chip(index).init(i2c_address + index);
 
-    // Ensure that the chip isn't in shutdown mode
-    write_reg(SHUTDOWN_REG, 1);
-
-    // This selects "picture mode" with frame #0 the frame to be displayed
-    write_reg(0,0);
-
-    // Select frame #0
-    write_reg(FRAME_SELECT_REG, 0);
-
-    // Send the PWM equivalent of our bitmap to the device
+    // Send the register equivalent of our framebuffer to the device
     display_image();
-
-    // This writes a 1-bit to the "enable" bit for every LED
-    unsigned char enable_cmd[] =
-    {
-        LED_CTRL_BASE_REG,
-        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
-    };
-
-    // Send the "enable all LEDs" command
-    transmit(enable_cmd, sizeof enable_cmd);
 }
 //=============================================================================================
 
@@ -449,7 +475,7 @@ void IS31FL3731::init(int i2c_address, unsigned char brightness)
 //=============================================================================================
 // set_brightness() - Define the PWM value of an "on" pixel and optionally update the display
 //=============================================================================================
-void IS31FL3731::set_brightness(unsigned char brightness, bool update_image)
+void IS31FL3731_Base::set_brightness(unsigned char brightness, bool update_image)
 {
     // Save the PWM value we want to use for an "on" pixel
     m_brightness = brightness;
@@ -460,15 +486,102 @@ void IS31FL3731::set_brightness(unsigned char brightness, bool update_image)
 //=============================================================================================
 
 
+//=============================================================================================
+// set_binary_mode() - Chooses between LED on/off bits and per-LED PWM values for expressing
+//                     the image, and optionally updates the display
+//=============================================================================================
+void IS31FL3731_Base::set_binary_mode(bool flag, bool update_image)
+{
+    m_is_binary = flag;
+    if (update_image) display_image();
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// store_frame() - Stores the image of our framebuffer in one of each chip's frames, for use
+//                 in an animation.  Frames 0 and 1 belong to print() and friends
+//=============================================================================================
+void IS31FL3731_Base::store_frame(int frame)
+{
+    // Building the image overwrites each chip's copy of it, so a background upload has to finish first
+    while (upload());
+
+    build_image();
+    for (int index = 0; index < m_chip_count; ++index) chip(index).store_frame(frame);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// clear_frame() - Stores an empty image in one of each chip's frames, for use in an animation
+//=============================================================================================
+void IS31FL3731_Base::clear_frame(int frame)
+{
+    for (int index = 0; index < m_chip_count; ++index) chip(index).clear_frame(frame);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// autoplay() - Has the chips cycle through frames on their own, with no further I2C traffic
+//
+// Passed: first    = The first frame to display (0 thru 7)
+//         count    = The number of frames to cycle through (1 thru 8)
+//         frame_ms = How long each frame is displayed (11 thru 704 ms, in steps of 11 ms)
+//         loops    = How many times to play the frames (1 thru 7) or 0 to play them forever.
+//                    When the frames have been played, the last one stays on the display
+//=============================================================================================
+void IS31FL3731_Base::autoplay(int first, int count, int frame_ms, int loops)
+{
+    for (int index = 0; index < m_chip_count; ++index) chip(index).autoplay(first, count, frame_ms, loops);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// stop_animation() - Returns to displaying whatever print() and friends last drew
+//=============================================================================================
+void IS31FL3731_Base::stop_animation()
+{
+    for (int index = 0; index < m_chip_count; ++index) chip(index).stop_animation();
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// breathe() - Has the chips fade LEDs in and out whenever the displayed frame changes
+//
+// Passed: fade_in_ms, fade_out_ms = 26 thru 3328 ms, rounded up to 26 ms times a power of 2
+//         off_ms                  = How long the LEDs stay dark between fades, 0 thru 448 ms,
+//                                   rounded up to 3.5 ms times a power of 2
+//=============================================================================================
+void IS31FL3731_Base::breathe(int fade_in_ms, int fade_out_ms, int off_ms)
+{
+    for (int index = 0; index < m_chip_count; ++index) chip(index).breathe(fade_in_ms, fade_out_ms, off_ms);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// stop_breathing() - Frame changes take effect immediately again
+//=============================================================================================
+void IS31FL3731_Base::stop_breathing()
+{
+    for (int index = 0; index < m_chip_count; ++index) chip(index).stop_breathing();
+}
+//=============================================================================================
+
+
 //=============================================================================================
 // set_orientation() - Sets the orientation of the display and optionally redisplays the
 //                     current image
 //=============================================================================================
-void IS31FL3731::set_orientation(bool orientation, bool update_image)
+void IS31FL3731_Base::set_orientation(bool orientation, bool update_image)
 {
     // Save the specified orientation for future reference
     m_orientation = orientation;
-    
+
     // If the caller wants us to update the image, make it so
     if (update_image) display_image();
 }
@@ -479,16 +592,13 @@ void IS31FL3731::set_orientation(bool orientation, bool update_image)
 //=============================================================================================
 // vertical_bar() - Draws a vertical bar at the specified column
 //=============================================================================================
-void IS31FL3731::vertical_bar(int column, bool update_image)
+void IS31FL3731_Base::vertical_bar(int column, bool update_image)
 {
     // Ensure that the column number the caller gave us physically exists
-    if (column < 0 || column >= PHYS_COLS) return;
+    if (column < 0 || column >= width()) return;
 
-    // Turn the column into a bit-mask
-    int mask = 1 << (15 - column);
-
-    // Turn that bit on in each row
-    for (int row = 0; row < PHYS_ROWS; ++row) m_bitmap[row] |= mask;
+    // Turn that column on in each row
+    for (int row = 0; row < m_rows; ++row) set_pixel(row, column, true);
 
     // And optionally update the display with this new vertical bar
     if (update_image) display_image();
@@ -498,33 +608,28 @@ void IS31FL3731::vertical_bar(int column, bool update_image)
 
 
 //=============================================================================================
-// print() - Merges the bitmap of a character into our display bitmap.
-// 
-// This does not transmit the bitmap to the device
+// print() - Merges the bitmap of a character into our framebuffer, with the left-most column
+//           of the character at "display_col"
+//
+// This does not transmit the framebuffer to the device
 //=============================================================================================
-void IS31FL3731::print(int display_row, int display_col, uint8_t c)
+void IS31FL3731_Base::print(int display_col, uint8_t c)
 {
-    // These are the dimensions of a character in our font
-    const int CHAR_COLS = 5;
-    const int CHAR_ROWS = 7;
-
     // Get the index in the font table where our 5x7 character begins
     int font_index = c * CHAR_ROWS;
 
-    // Determine which bit number the left-most bit of the 5 bit-wide character should reside in
-    int shift = (PHYS_COLS - CHAR_COLS + 1) - display_col;
-
     // Loop through each row of the character...
     for (int char_row = 0; char_row < CHAR_ROWS; ++char_row)
     {
-        // If it's off the end of the display, we're done
-        if (display_row >= MAX_ROWS) break;
-        
         // Fetch the bits for this row of the character
-        uint16_t bits = pgm_read_byte_near(font + font_index++);
+        uint8_t bits = pgm_read_byte_near(font + font_index++);
 
-        // And merge those bits into our display bitmap
-        m_bitmap[display_row++] |= (bits << shift);
+        // And merge those bits into our framebuffer, left-most column first
+        for (int char_col = 0; char_col < CHAR_COLS; ++char_col)
+        {
+            if (bits & (1 << (CHAR_COLS - 1 - char_col)))
+                set_pixel(m_text_row + char_row, display_col + char_col, true);
+        }
     }
 }
 //=============================================================================================
@@ -534,82 +639,188 @@ void IS31FL3731::print(int display_row, int display_col, uint8_t c)
 //=============================================================================================
 // print() - Displays two characters on the screen
 //=============================================================================================
-void IS31FL3731::print(char c1, char c2)
+void IS31FL3731_Base::print(char c1, char c2)
 {
-    // Clear all bits to off
-    memset(m_bitmap, 0, sizeof m_bitmap);
+    char str[3] = { c1, c2, 0 };
+    print(str);
+}
+//=============================================================================================
 
-    // Print either 1 or 2 characters
-    if (c2 == 0)
-        print(0, 5, (unsigned char)c1);
-    else
-    {
-        print(0, 2, (unsigned char)c1);
-        print(0, 8, (unsigned char)c2);
-    }
 
-    // Transmit our bitmap to the device
-    display_image();
+//=============================================================================================
+// print() - Print an integer value.  If it doesn't fit on the display, it scrolls
+//=============================================================================================
+void IS31FL3731_Base::print(int value)
+{
+    char buffer[12];
+    snprintf(buffer, sizeof buffer, "%d", value);
+    print(buffer);
 }
 //=============================================================================================
 
 
+
+
 //=============================================================================================
-// print() - Print an integer value between -9 and 99
+// print() - Print a rounded floating point value
 //=============================================================================================
-void IS31FL3731::print(int value)
+void IS31FL3731_Base::print(double value)
 {
-    char c1 = '*', c2 = '*';
+    print((int)(value + .5));
+}
+//=============================================================================================
 
-    // If it's a negative one digit number...
-    if (value >= -9 && value <= -1)
-    {
-        c1 = '-';
-        c2 = '0' - value;
-    }
 
-    // If it's a positive single-digit number...
-    else if (value >= 0 && value <= 9)
-    {
-        c1 = '0' + value;
-        c2 = 0;
-    }
 
-    // If it's a two digit number...
-    if (value >= 10 && value <= 99)
+
+//=============================================================================================
+// print() - Print a string, centered on the display.  If it doesn't fit, it scrolls
+//=============================================================================================
+void IS31FL3731_Base::print(const char* str)
+{
+    // How many columns does this string need?  Characters are separated by a blank column
+    int length = strlen(str);
+    int text_cols = length * (CHAR_COLS + 1) - 1;
+
+    // If it won't fit, scroll it.  If it's already scrolling, leave it be
+    if (text_cols > width())
     {
-        c1 = '0' + value / 10;
-        c2 = '0' + value % 10;
+        if (!m_marquee_timer.is_running() || strncmp(str, m_marquee, MARQUEE_MAX) != 0) marquee(str);
+        return;
     }
 
-    // And display the two characters
-    print(c1, c2);
+    // This replaces any scrolling text
+    m_marquee_timer.stop();
+
+    // Clear all bits to off
+    memset(framebuffer(), 0, m_rows * m_stride);
+
+    // Draw the characters, centered
+    int col = (width() - text_cols) / 2;
+    for (int i = 0; i < length; ++i, col += CHAR_COLS + 1) print(col, (uint8_t)str[i]);
+
+    // Transmit our framebuffer to the device
+    display_image();
+}
+//=============================================================================================
+
+
+
+//=============================================================================================
+// marquee() - Starts a string scrolling across the display, one column every "column_ms"
+//             milliseconds.  If "repeat" is true, it starts over once it has scrolled off
+//=============================================================================================
+void IS31FL3731_Base::marquee(const char* str, int column_ms, bool repeat)
+{
+    // Keep our own copy: the caller's buffer may well be strfloat()'s static buffer
+    strncpy(m_marquee, str, MARQUEE_MAX);
+    m_marquee[MARQUEE_MAX] = 0;
+    m_is_marquee_repeating = repeat;
+
+    // The text enters from the right edge of an empty display
+    memset(framebuffer(), 0, m_rows * m_stride);
+    marquee_restart();
+    display_image();
+
+    // And start scrolling
+    m_marquee_timer.start(column_ms);
 }
 //=============================================================================================
 
 
- 
+//=============================================================================================
+// marquee() - Starts an integer scrolling across the display
+//=============================================================================================
+void IS31FL3731_Base::marquee(int value, int column_ms, bool repeat)
+{
+    char buffer[12];
+    snprintf(buffer, sizeof buffer, "%d", value);
+    marquee(buffer, column_ms, repeat);
+}
+//=============================================================================================
+
 
 //=============================================================================================
-// print() - Print a rounded floating point value between -9 and 99
+// marquee_restart() - Points the marquee at the first column of the first character
 //=============================================================================================
-void IS31FL3731::print(double value)
+void IS31FL3731_Base::marquee_restart()
 {
-    print((int)(value + .5));
+    m_marquee_index = 0;
+    m_marquee_col = 0;
+    load_glyph(m_marquee[0]);
 }
 //=============================================================================================
 
 
+//=============================================================================================
+// load_glyph() - Turns the font's rows for a character into columns, once per character, so
+//                that each step of the marquee only has to shift in one pre-built column
+//
+// In m_glyph[], bit 0 of a column is the top row
+//=============================================================================================
+void IS31FL3731_Base::load_glyph(uint8_t c)
+{
+    memset(m_glyph, 0, sizeof m_glyph);
+
+    int font_index = c * CHAR_ROWS;
+    for (int row = 0; row < CHAR_ROWS; ++row)
+    {
+        uint8_t bits = pgm_read_byte_near(font + font_index++);
+        for (int col = 0; col < CHAR_COLS; ++col)
+        {
+            if (bits & (1 << (CHAR_COLS - 1 - col))) m_glyph[col] |= (1 << row);
+        }
+    }
+}
+//=============================================================================================
 
 
 //=============================================================================================
-// print() - Print a 2 character string
+// marquee_step() - Scrolls the display one column to the left, shifting in the next column of
+//                  the text at the right edge
 //=============================================================================================
-void IS31FL3731::print(const char* str)
+void IS31FL3731_Base::marquee_step()
 {
-    char c1 = str[0];
-    char c2 = str[1];
-    if (c1 == 0) c2 = 0;
-    print(c1, c2);
+    uint8_t column = 0;
+
+    // While there's text left, each character contributes its columns plus a blank one
+    if (m_marquee[m_marquee_index])
+    {
+        if (m_marquee_col < CHAR_COLS) column = m_glyph[m_marquee_col];
+        if (++m_marquee_col > CHAR_COLS)
+        {
+            m_marquee_col = 0;
+            load_glyph(m_marquee[++m_marquee_index]);
+        }
+    }
+
+    // Once the text is done, blank columns scroll it off the display
+    else if (++m_marquee_col >= width())
+    {
+        if (m_is_marquee_repeating)
+            marquee_restart();
+        else
+            m_marquee_timer.stop();
+    }
+
+    // Shift every row of the framebuffer one column to the left
+    for (int row = 0; row < m_rows; ++row)
+    {
+        uint8_t* p = framebuffer() + row * m_stride;
+        for (int i = 0; i < m_stride; ++i)
+        {
+            uint8_t carry = (i + 1 < m_stride) ? (p[i + 1] >> 7) : 0;
+            p[i] = (p[i] << 1) | carry;
+        }
+    }
+
+    // And the new column enters at the right edge
+    const int right_col = width() - 1;
+    for (int row = 0; row < CHAR_ROWS; ++row)
+    {
+        set_pixel(m_text_row + row, right_col, (column >> row) & 1);
+    }
+
+    display_image();
 }
 //=============================================================================================
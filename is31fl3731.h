@@ -1,12 +1,25 @@
 //=============================================================================================
-// is31fl3731.h - Defines a two-character display driver for the AdaFruit IS31FL3731 Led Matrix
+// is31fl3731.h - Defines a text display driver for IS31FL3731 LED matrix boards
+//
+// IS31FL3731<GEOMETRY, CHIPS> drives CHIPS identical boards (see led_geometry.h) laid side by
+// side as one wide display, with chip N at I2C address i2c_address + N.  The template only
+// supplies the geometry and the storage; all of the logic lives in IS31FL3731_Base, so that
+// every geometry shares one copy of the code.
+//
+// Drawing happens in a 1-bit framebuffer.  To display it, each chip's image is built from the
+// framebuffer and uploaded to the chip's back frame, and once every chip has its new image, all
+// of them flip to it together.
 //=============================================================================================
 #ifndef _IS31FL3731_H_
 #define _IS31FL3731_H_
 
 #include <stdint.h>
+#include <stddef.h>
+#include "mstimer.h"
+#include "led_geometry.h"
+#include "is31fl3731_chip.h"
 
-class IS31FL3731
+class IS31FL3731_Base
 {
 public:
 
@@ -16,6 +29,11 @@ public:
     // Call this to set the brightness of an "on" LED
     void    set_brightness(unsigned char brightness, bool update_display = false);
 
+    // Call this with "true" to display the image through the LED on/off bits instead of through
+    // each LED's PWM value.  Every LED then shares one brightness, and an image costs 18 bytes
+    // instead of 144
+    void    set_binary_mode(bool flag, bool update_display = true);
+
     // Call this to determine the display orientation.  true = Normal, false = Upside down
     void    set_orientation(bool orientation, bool update_display = true);
 
@@ -28,46 +46,139 @@ public:
     // Call this to print a pair of characters
     void    print(char c1, char c2);
 
-    // Call this to print a two digit integer
+    // Call this to print an integer.  If it doesn't fit, it scrolls
     void    print(int);
 
-    // Call this to print a rounded two-digit floating point number
+    // Call this to print a rounded floating point number
     void    print(double);
 
-    // Call this to print a 2-character string
+    // Call this to print a string, centered.  If it doesn't fit, it scrolls
     void    print(const char*);
 
+    // Call this to scroll a string or an integer across the display, one column at a time.
+    // service() does the scrolling
+    void    marquee(const char* str, int column_ms = 100, bool repeat = true);
+    void    marquee(int value, int column_ms = 100, bool repeat = true);
+
+    // Call this to store the current image (or an empty one) in frame 2 thru 7, for animations
+    void    store_frame(int frame);
+    void    clear_frame(int frame);
+
+    // Has the chips cycle through "count" frames starting at "first", "frame_ms" apiece, "loops"
+    // times (0 = forever).  Once started, they need no further help from us
+    void    autoplay(int first, int count, int frame_ms, int loops = 0);
+
+    // Stops auto-play and goes back to displaying what print() and friends last drew
+    void    stop_animation();
+
+    // Has the chips fade LEDs in and out whenever the displayed frame changes
+    void    breathe(int fade_in_ms, int fade_out_ms, int off_ms = 0);
+    void    stop_breathing();
+
+    // Call this with "true" to have images uploaded a piece at a time by service()
+    void    set_background(bool flag) {m_is_background = flag;}
+
+    // Call this from loop() to scroll the marquee and to upload in the background.  Returns
+    // true while an image is still on its way to the device
+    bool    service();
+
+    // The size of the display, in LEDs
+    int     width()  {return m_cols * m_chip_count;}
+    int     height() {return m_rows;}
+
 protected:
 
-    // This is a generic routine that transmits to the device via I2C
-    void    transmit(const unsigned char* data, size_t length);
+    // Constructor: the template tells us the board's geometry and how many boards there are
+    IS31FL3731_Base(int cols, int rows, const uint8_t* led_map, int chip_count);
+
+    // The template owns the chips and the framebuffer
+    virtual IS31FL3731_Chip& chip(int index) = 0;
+    virtual uint8_t*         framebuffer() = 0;
 
-    // This updates a single 8-bit register on the device
-    void    write_reg(unsigned char address, unsigned char value);
+    // Turns an LED of the framebuffer on or off, or finds out whether it's on
+    void    set_pixel(int row, int col, bool on);
+    bool    get_pixel(int row, int col);
 
-    // Sends the bitmap to the device
+    // Builds each chip's image from the framebuffer
+    void    build_image();
+
+    // Sends the framebuffer to the device
     void    display_image();
 
-    // Displays a single character
-    void    print(int row, int col, uint8_t c);
+    // Moves a pending image one step closer to being displayed
+    bool    upload();
+
+    // Draws a single character with its left-most column at "col"
+    void    print(int col, uint8_t c);
+
+    // Marquee helpers: start over at the first character, build a character's columns, and
+    // scroll by one column
+    void    marquee_restart();
+    void    load_glyph(uint8_t c);
+    void    marquee_step();
+
+    // The dimensions of a character in our font
+    enum { CHAR_COLS = 5, CHAR_ROWS = 7 };
+
+    // The longest string the marquee will scroll
+    enum { MARQUEE_MAX = 32 };
 
-    // The number of columns and rows that our bitmap and the device can handle
-    enum { MAX_COLS = 16, MAX_ROWS = 8};
+    // The geometry of one board, its LED map (in PROGMEM), and the number of boards
+    int           m_cols, m_rows;
+    const uint8_t* m_led_map;
+    int           m_chip_count;
 
-    // The number of physical LEDs that we have
-    enum { PHYS_COLS = 15, PHYS_ROWS = 7};
+    // The number of bytes in one row of the framebuffer
+    int           m_stride;
 
-    // A 16x9 bitmap of the display
-    uint16_t m_bitmap[MAX_ROWS];
+    // The row that the top of a character goes in
+    int           m_text_row;
 
     // This is the value that will be PWM'd for an LED that is on
     unsigned char m_brightness;
 
     // Display orientation
-    bool     m_orientation;
+    bool          m_orientation;
+
+    // When true, the image is expressed through the LED on/off bits rather than through PWM
+    bool          m_is_binary;
+
+    // Whether an image is on its way to the chips, and whether uploads are spread across calls
+    // to service()
+    bool          m_is_upload_pending;
+    bool          m_is_background;
+
+    // The marquee's text, the character and column that scroll in next, and whether it repeats
+    char          m_marquee[MARQUEE_MAX + 1];
+    int           m_marquee_index;
+    int           m_marquee_col;
+    bool          m_is_marquee_repeating;
+
+    // The columns of the character that is scrolling in.  Bit 0 is the top row
+    uint8_t       m_glyph[CHAR_COLS];
+
+    // Paces the marquee
+    msTimer       m_marquee_timer;
+};
+
+
+template <class GEOMETRY, int CHIPS = 1>
+class IS31FL3731 : public IS31FL3731_Base
+{
+public:
+
+    IS31FL3731() : IS31FL3731_Base(GEOMETRY::COLS, GEOMETRY::ROWS, led_map<GEOMETRY>::table, CHIPS) {}
+
+protected:
+
+    IS31FL3731_Chip& chip(int index) {return m_chip[index];}
+    uint8_t*         framebuffer()   {return m_framebuffer;}
+
+    // One of these per board
+    IS31FL3731_Chip m_chip[CHIPS];
 
-    // The I2C address of the device we're controlling
-    unsigned char m_i2c_address;
+    // One bit per LED, row by row.  The left-most LED of a row is the top bit of its first byte
+    uint8_t  m_framebuffer[GEOMETRY::ROWS * ((GEOMETRY::COLS * CHIPS + 7) / 8)];
 };
 
 #endif
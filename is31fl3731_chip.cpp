@@ -0,0 +1,338 @@
+//=============================================================================================
+// is31fl3731_chip.cpp - Implements the register-level side of one IS31FL3731 LED matrix driver
+//=============================================================================================
+#include <string.h>
+#include "is31fl3731_chip.h"
+#include <Wire.h>
+#include <Arduino.h>
+
+#define FRAME_SELECT_REG  0xFD
+#define CONFIG_FRAME      0x0B
+#define PWM_BASE_REG      0x24
+#define LED_CTRL_BASE_REG 0x00
+#define SHUTDOWN_REG      0x0A
+#define CONFIG_REG        0x00
+#define PICTURE_REG       0x01
+#define AUTOPLAY1_REG     0x02
+#define AUTOPLAY2_REG     0x03
+#define BREATH1_REG       0x08
+#define BREATH2_REG       0x09
+
+// Bits in the configuration register
+#define MODE_AUTOPLAY     0x08
+
+// Bits in breath-control register 2
+#define BREATH_ENABLE     0x10
+
+// The chip's auto-play clock, in milliseconds per tick of the frame delay
+#define AUTOPLAY_TICK_MS  11
+
+// Starting a new I2C transaction costs more than re-sending this many unchanged registers
+#define MAX_MERGE_GAP     2
+
+
+//=============================================================================================
+// transmit() - Transmits data to the device via I2C
+//=============================================================================================
+void IS31FL3731_Chip::transmit(const uint8_t* data, size_t length)
+{
+    Wire.flush();
+    Wire.beginTransmission(m_i2c_address);
+    Wire.write(data, length);
+    Wire.endTransmission();
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// write_reg() - Writes an 8-bit value to an 8-bit address on the device
+//=============================================================================================
+void IS31FL3731_Chip::write_reg(unsigned char address, unsigned char value)
+{
+    unsigned char buffer[2] = { address, value };
+    transmit(buffer, 2);
+}
+//=============================================================================================
+
+
+
+//=============================================================================================
+// write_regs() - Writes a block of consecutive registers.  The device auto-increments the
+//                register address, so each transaction carries as many values as fit in the
+//                Wire library's buffer (after the register address)
+//=============================================================================================
+void IS31FL3731_Chip::write_regs(unsigned char address, const unsigned char* data, size_t length)
+{
+    const size_t max_chunk = BUFFER_LENGTH - 1;
+
+    while (length)
+    {
+        size_t chunk = (length < max_chunk) ? length : max_chunk;
+
+        Wire.flush();
+        Wire.beginTransmission(m_i2c_address);
+        Wire.write(address);
+        Wire.write(data, chunk);
+        Wire.endTransmission();
+
+        address += chunk;
+        data    += chunk;
+        length  -= chunk;
+    }
+}
+//=============================================================================================
+
+
+
+//=============================================================================================
+// select_page() - Points subsequent register writes at a frame or at the control registers
+//=============================================================================================
+void IS31FL3731_Chip::select_page(unsigned char page)
+{
+    if (page == m_page) return;
+    write_reg(FRAME_SELECT_REG, page);
+    m_page = page;
+}
+//=============================================================================================
+
+
+
+//=============================================================================================
+// init() - Call once at startup
+//=============================================================================================
+void IS31FL3731_Chip::init(unsigned char i2c_address)
+{
+    // Save the I2C address for future use
+    m_i2c_address = i2c_address;
+
+    // We have no idea which page the chip has selected
+    m_page = 0xFF;
+
+    // There's no image on its way to the device
+    m_is_changed = false;
+    m_upload_index = 0;
+
+    // Select frame #9, which is actually the control registers
+    select_page(CONFIG_FRAME);
+
+    // Ensure that the chip isn't in shutdown mode
+    write_reg(SHUTDOWN_REG, 1);
+
+    // This selects "picture mode" with frame #0 the frame to be displayed
+    write_reg(CONFIG_REG, 0);
+    write_reg(PICTURE_REG, 0);
+    m_front = 0;
+
+    // Clear every register of each frame that we draw into.  From here on, we always know
+    // what each frame holds
+    memset(m_chip, 0, sizeof m_chip);
+    for (int frame = 0; frame < FRAMES; ++frame)
+    {
+        select_page(frame);
+        write_regs(0, m_chip[frame], FRAME_REGS);
+    }
+
+    // The image we want displayed is what the chip is displaying
+    memcpy(m_image, m_chip[m_front], sizeof m_image);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// begin_image() - Starts building an image with every LED dark
+//
+// In PWM mode, every LED is enabled and the image is expressed as a PWM value per LED.  In
+// binary mode, every LED has the same PWM value and the image is expressed by the LED on/off
+// bits, so that a change to the image touches only a few of the 18 on/off registers
+//=============================================================================================
+void IS31FL3731_Chip::begin_image(bool is_binary, unsigned char brightness)
+{
+    m_is_binary  = is_binary;
+    m_brightness = brightness;
+
+    memset(m_image, 0, sizeof m_image);
+
+    // In PWM mode, every LED is switched on.  In binary mode, every LED is at full brightness
+    if (m_is_binary)
+        memset(m_image + PWM_BASE_REG, m_brightness, LED_COUNT);
+    else
+        memset(m_image + LED_CTRL_BASE_REG, 0xFF, LED_COUNT / 8);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// set_led() - Lights an LED in the image being built
+//=============================================================================================
+void IS31FL3731_Chip::set_led(int led)
+{
+    if (m_is_binary)
+        m_image[LED_CTRL_BASE_REG + led / 8] |= (1 << (led % 8));
+    else
+        m_image[PWM_BASE_REG + led] = m_brightness;
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// start_upload() - Starts sending the image to the back frame.  A new image replaces any that
+//                  was still on its way: registers already sent won't be sent again
+//=============================================================================================
+void IS31FL3731_Chip::start_upload()
+{
+    m_upload_index = 0;
+    m_is_changed = memcmp(m_image, m_chip[m_front], sizeof m_image) != 0;
+}
+//=============================================================================================
+
+
+
+//=============================================================================================
+// upload() - Compares the new image against what the back frame holds, and sends the next run
+//            of registers that differ.  Changed registers separated by just a few unchanged
+//            ones are merged into a single auto-increment write
+//
+// Returns: true if a run was sent, false if the back frame holds the new image (or if the
+//          new image is what's already being displayed)
+//=============================================================================================
+bool IS31FL3731_Chip::upload()
+{
+    if (!m_is_changed) return false;
+
+    const int max_run = BUFFER_LENGTH - 1;
+    const int back = m_front ^ 1;
+    unsigned char* chip = m_chip[back];
+
+    // Skip over the registers that are already correct
+    int index = m_upload_index;
+    while (index < FRAME_REGS && m_image[index] == chip[index]) ++index;
+
+    // If there's nothing left to send, the back frame is complete
+    if (index == FRAME_REGS) return false;
+
+    // Find the end of this run, absorbing any short gaps of unchanged registers
+    int first = index, last = index;
+    for (++index; index < FRAME_REGS && index - first < max_run; ++index)
+    {
+        if (m_image[index] != chip[index])
+            last = index;
+        else if (index - last > MAX_MERGE_GAP)
+            break;
+    }
+
+    // Send the run, and remember that the back frame now holds it
+    int length = last - first + 1;
+    select_page(back);
+    write_regs(first, m_image + first, length);
+    memcpy(chip + first, m_image + first, length);
+    m_upload_index = last + 1;
+    return true;
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// flip() - If the back frame holds a new image, make it the visible frame
+//=============================================================================================
+void IS31FL3731_Chip::flip()
+{
+    if (!m_is_changed) return;
+
+    m_front ^= 1;
+    select_page(CONFIG_FRAME);
+    write_reg(PICTURE_REG, m_front);
+    m_is_changed = false;
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// store_frame() - Stores the image in one of the frames that we don't draw into
+//=============================================================================================
+void IS31FL3731_Chip::store_frame(int frame)
+{
+    if (frame < FRAMES || frame > 7) return;
+    select_page(frame);
+    write_regs(0, m_image, FRAME_REGS);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// clear_frame() - Stores an empty image in one of the frames that we don't draw into
+//=============================================================================================
+void IS31FL3731_Chip::clear_frame(int frame)
+{
+    if (frame < FRAMES || frame > 7) return;
+
+    unsigned char blank[FRAME_REGS];
+    memset(blank, 0, sizeof blank);
+    select_page(frame);
+    write_regs(0, blank, FRAME_REGS);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// exponent() - Returns the smallest e (0 thru 7) for which base * 2^e is at least "value"
+//=============================================================================================
+static unsigned char exponent(unsigned int value, unsigned int base)
+{
+    unsigned char e = 0;
+    while (e < 7 && (base << e) < value) ++e;
+    return e;
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// autoplay() - Programs the loop count, frame count, and frame time, then starts playing
+//=============================================================================================
+void IS31FL3731_Chip::autoplay(int first, int count, int frame_ms, int loops)
+{
+    // Convert the frame time to ticks of the chip's auto-play clock.  64 ticks is written as 0
+    int ticks = (frame_ms + AUTOPLAY_TICK_MS / 2) / AUTOPLAY_TICK_MS;
+    if (ticks < 1)  ticks = 1;
+    if (ticks > 64) ticks = 64;
+
+    select_page(CONFIG_FRAME);
+    write_reg(AUTOPLAY1_REG, ((loops & 7) << 4) | (count & 7));
+    write_reg(AUTOPLAY2_REG, ticks & 63);
+    write_reg(CONFIG_REG, MODE_AUTOPLAY | (first & 7));
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// stop_animation() - Goes back to picture mode, showing the frame we last flipped to
+//=============================================================================================
+void IS31FL3731_Chip::stop_animation()
+{
+    select_page(CONFIG_FRAME);
+    write_reg(CONFIG_REG, 0);
+    write_reg(PICTURE_REG, m_front);
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// breathe() - Programs the fade-in, fade-out, and extinguish times, and enables breathing
+//=============================================================================================
+void IS31FL3731_Chip::breathe(int fade_in_ms, int fade_out_ms, int off_ms)
+{
+    select_page(CONFIG_FRAME);
+    write_reg(BREATH1_REG, (exponent(fade_out_ms, 26) << 4) | exponent(fade_in_ms, 26));
+    write_reg(BREATH2_REG, BREATH_ENABLE | exponent(off_ms * 2, 7));
+}
+//=============================================================================================
+
+
+//=============================================================================================
+// stop_breathing() - Frame changes take effect immediately again
+//=============================================================================================
+void IS31FL3731_Chip::stop_breathing()
+{
+    select_page(CONFIG_FRAME);
+    write_reg(BREATH2_REG, 0);
+}
+//=============================================================================================
@@ -0,0 +1,97 @@
+//=============================================================================================
+// is31fl3731_chip.h - Defines the register-level side of one IS31FL3731 LED matrix driver chip
+//
+// The caller builds the registers of the image it wants displayed with begin_image() and
+// set_led(), then calls start_upload().  Each call to upload() sends one run of registers that
+// differ from what the back frame holds, and flip() then makes the back frame visible with a
+// single write to the picture-display register.  Frames 0 and 1 are used for that; frames 2
+// thru 7 are free for animations
+//=============================================================================================
+#ifndef _IS31FL3731_CHIP_H_
+#define _IS31FL3731_CHIP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+class IS31FL3731_Chip
+{
+public:
+
+    // Call this once at startup: takes the chip out of shutdown and clears frames 0 and 1
+    void    init(unsigned char i2c_address);
+
+    // Call this to start building an image.  In binary mode, every LED gets "brightness" as its
+    // PWM value and set_led() turns on its on/off bit.  Otherwise, every LED is switched on and
+    // set_led() gives it "brightness" as its PWM value
+    void    begin_image(bool is_binary, unsigned char brightness);
+
+    // Lights an LED in the image being built
+    void    set_led(int led);
+
+    // Call this once the image is built
+    void    start_upload();
+
+    // Sends the next run of changed registers to the back frame.  Returns false once the
+    // back frame holds the new image
+    bool    upload();
+
+    // If a new image has been uploaded, makes it the visible frame
+    void    flip();
+
+    // Stores the image (or an empty one) in frame 2 thru 7, for use in an animation
+    void    store_frame(int frame);
+    void    clear_frame(int frame);
+
+    // Auto-play and breathing.  See IS31FL3731_Base for the parameters
+    void    autoplay(int first, int count, int frame_ms, int loops);
+    void    stop_animation();
+    void    breathe(int fade_in_ms, int fade_out_ms, int off_ms);
+    void    stop_breathing();
+
+protected:
+
+    // This is a generic routine that transmits to the device via I2C
+    void    transmit(const unsigned char* data, size_t length);
+
+    // This updates a single 8-bit register on the device
+    void    write_reg(unsigned char address, unsigned char value);
+
+    // This writes a block of consecutive registers, using as few I2C transactions as possible
+    void    write_regs(unsigned char address, const unsigned char* data, size_t length);
+
+    // Selects which page (frame or control registers) subsequent writes go to
+    void    select_page(unsigned char page);
+
+    // The number of LEDs (and therefore PWM registers) the chip has
+    enum { LED_COUNT = 144 };
+
+    // The number of registers in a frame: LED on/off bits, blink bits, and PWM values
+    enum { FRAME_REGS = 0xB4 };
+
+    // The number of frames we draw into.  One is displayed while the other is being drawn
+    enum { FRAMES = 2 };
+
+    // The registers of the frame we want displayed, in register order
+    unsigned char m_image[FRAME_REGS];
+
+    // What each frame's registers currently hold
+    unsigned char m_chip[FRAMES][FRAME_REGS];
+
+    // Whether the image being built is binary, and the brightness of a lit LED
+    bool          m_is_binary;
+    unsigned char m_brightness;
+
+    // The frame being displayed, and the page that writes currently go to
+    unsigned char m_front;
+    unsigned char m_page;
+
+    // Whether the image differs from the displayed frame, and the register where the upload
+    // resumes
+    bool          m_is_changed;
+    int           m_upload_index;
+
+    // The I2C address of the device we're controlling
+    unsigned char m_i2c_address;
+};
+
+#endif
@@ -0,0 +1,70 @@
+//=============================================================================================
+// led_geometry.h - Describes how the LEDs of a matrix board are wired to an IS31FL3731
+//
+// A geometry is a struct that gives the board's dimensions and a constexpr led() that returns
+// the chip's LED number (0 thru 143) for a row and column of the board.  The LED number is the
+// offset of the LED's PWM register, and the bit number of its on/off bit.
+//
+// led_map<GEOMETRY>::table is that function evaluated at compile time for every row and column
+// (row by row), and stored in PROGMEM
+//=============================================================================================
+#ifndef _LED_GEOMETRY_H_
+#define _LED_GEOMETRY_H_
+#include <stdint.h>
+#include <Arduino.h>
+
+
+//---------------------------------------------------------------------------------------------
+// Adafruit 15x7 CharlieWing.  The left 8 columns count up from the bottom row, 16 LEDs apart.
+// The right 7 columns count down from the right edge, starting at LED 8 in the top row
+//---------------------------------------------------------------------------------------------
+struct CharlieWing15x7
+{
+    enum { COLS = 15, ROWS = 7 };
+
+    static constexpr uint8_t led(int row, int col)
+    {
+        return (col < 8) ? (7 - row) + col * 16 : (8 + row) + (15 - col) * 16;
+    }
+};
+//---------------------------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------------------------
+// Adafruit 16x9 CharliePlex.  LEDs are numbered row by row
+//---------------------------------------------------------------------------------------------
+struct CharliePlex16x9
+{
+    enum { COLS = 16, ROWS = 9 };
+
+    static constexpr uint8_t led(int row, int col) { return row * 16 + col; }
+};
+//---------------------------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------------------------
+// The machinery that expands a geometry into a table: led_seq<0, 1, ... N-1> is a list of
+// table indices, and the table's initializer calls led() once per index
+//---------------------------------------------------------------------------------------------
+template <int... I> struct led_seq {};
+
+template <int N, int... I> struct make_led_seq : make_led_seq<N - 1, N - 1, I...> {};
+template <int... I> struct make_led_seq<0, I...> { typedef led_seq<I...> type; };
+
+template <class GEOMETRY, class SEQ = typename make_led_seq<GEOMETRY::ROWS * GEOMETRY::COLS>::type>
+struct led_map;
+
+template <class GEOMETRY, int... I>
+struct led_map<GEOMETRY, led_seq<I...>>
+{
+    static const uint8_t table[sizeof...(I)];
+};
+
+template <class GEOMETRY, int... I>
+const uint8_t led_map<GEOMETRY, led_seq<I...>>::table[sizeof...(I)] PROGMEM =
+{
+    GEOMETRY::led(I / GEOMETRY::COLS, I % GEOMETRY::COLS)...
+};
+//---------------------------------------------------------------------------------------------
+
+#endif
@@ -1,6 +1,13 @@
 #include "mstimer.h"
 #include <Arduino.h>  
 
+// In the simulator, every timer tells the virtual clock when it's going to expire
+#ifdef __AVR__
+#define note_deadline(when)
+#else
+#define note_deadline(when) sim_deadline(when)
+#endif
+
 
 //=========================================================================================================
 // start() - Starts or restarts the timer
@@ -10,6 +17,9 @@ void msTimer::start(unsigned int duration_ms)
     m_duration_ms = duration_ms;
     m_start_time  = millis();
     m_is_running  = true;
+
+    // A timer expires once more than "duration" milliseconds have elapsed
+    note_deadline(m_start_time + m_duration_ms + 1);
 }
 //=========================================================================================================
 
@@ -47,6 +57,9 @@ bool msTimer::is_expired()
     // If the restarted timer is <already> expired, it restarts right now
     if (elapsed > m_duration_ms) m_start_time = now;
 
+    // Let the simulator know when the restarted timer is next due
+    note_deadline(m_start_time + m_duration_ms + 1);
+
     // Tell the caller that the timer expired
     return true;
 }
@@ -72,6 +85,7 @@ bool OneShot::is_expired()
     {
         m_is_kicked = false;
         m_start_time = now;
+        note_deadline(m_start_time + m_duration_ms + 1);
         return false;
     }
 
@@ -100,6 +114,7 @@ void ThreadSafeOneShot::start_from_isr()
 {
     m_start_time_from_isr = millis();
     m_is_started_from_isr = true;
+    note_deadline(m_start_time_from_isr + m_duration_ms + 1);
 }
 //=========================================================================================================
 
@@ -135,6 +150,7 @@ bool ThreadSafeOneShot::is_expired()
     {
         m_is_kicked = false;
         m_start_time = now;
+        note_deadline(m_start_time + m_duration_ms + 1);
         return false;
     }
 
@@ -74,6 +74,9 @@ class ThreadSafeOneShot : public OneShot
 {
 public:
 
+    // Constructor
+    ThreadSafeOneShot() { m_is_started_from_isr = false; }
+
     // Call this to set the durtation of the timer that will be started via "start_from_isr()"
     void    set_duration(unsigned int duration_ms) { m_duration_ms = duration_ms; }
 
@@ -7,7 +7,7 @@
 //=========================================================================================================
 // set_output_limits() Define the minimum and maximum legal values for the output
 //=========================================================================================================
-void CPIDController::set_output_limits(pid_t lower_limit, pid_t upper_limit)
+void CPIDController::set_output_limits(pidval_t lower_limit, pidval_t upper_limit)
 {
     m_lower_limit = lower_limit;
     m_upper_limit = upper_limit;
@@ -18,7 +18,7 @@ void CPIDController::set_output_limits(pid_t lower_limit, pid_t upper_limit)
 //=========================================================================================================
 // new_setpoint() - Starts a new setpoint.
 //=========================================================================================================
-void CPIDController::new_setpoint(pid_t setpoint)
+void CPIDController::new_setpoint(pidval_t setpoint)
 {
     m_setpoint = setpoint;
 }
@@ -39,7 +39,7 @@ void CPIDController::reset()
 //=========================================================================================================
 // set_constants() - Stores new constants and resets the integral term
 //=========================================================================================================
-void CPIDController::set_constants(pid_t kp, pid_t ki, pid_t kd)
+void CPIDController::set_constants(pidval_t kp, pidval_t ki, pidval_t kd)
 {
     m_kp = kp;
     m_ki = ki;
@@ -57,28 +57,28 @@ void CPIDController::set_constants(pid_t kp, pid_t ki, pid_t kd)
 //
 // Do NOT pass 0 (or even very small numbers) for dt!!
 //=========================================================================================================
-pid_t CPIDController::compute(pid_t pv, pid_t dt)
+pidval_t CPIDController::compute(pidval_t pv, pidval_t dt)
 {
     // How far away is the present value from the desired setpoint?
-    pid_t error = m_setpoint - pv;
+    pidval_t error = m_setpoint - pv;
 
     // Compute the proportional term
-    pid_t P = m_kp * error;
+    pidval_t P = m_kp * error;
 
     // Accumuate error
     m_integral += error * dt;
 
     // Compute the integral term
-    pid_t I = m_ki * m_integral;
+    pidval_t I = m_ki * m_integral;
 
     // Compute the rate of change of the error
-    pid_t rate_of_change = (error - m_previous_error) / dt;
+    pidval_t rate_of_change = (error - m_previous_error) / dt;
     
     // Comute the derivative term
-    pid_t D = m_kd * rate_of_change;
+    pidval_t D = m_kd * rate_of_change;
 
     // Compute the new output value
-    pid_t output = P + I + D;
+    pidval_t output = P + I + D;
 
     // Make sure we keep coloring inside the lines
     if (output > m_upper_limit)
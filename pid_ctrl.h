@@ -4,7 +4,7 @@
 #ifndef _PID_CTRL_H_
 #define _PID_CTRL_H_
 
-typedef float pid_t;
+typedef float pidval_t;
 
 //=========================================================================================================
 // At system startup, the following sequence of events must happen:
@@ -26,33 +26,33 @@ public:
     void    reset();
 
     // Call this to set the output limits to a physically possible range
-    void    set_output_limits(pid_t lower_limit, pid_t upper_limit);
+    void    set_output_limits(pidval_t lower_limit, pidval_t upper_limit);
 
     // Call this to start a new setpoint.  
-    void    new_setpoint(pid_t setpoint);
+    void    new_setpoint(pidval_t setpoint);
 
     // Stores new PID constants.  This resets the integral
-    void    set_constants(pid_t kp, pid_t ki, pid_t kd);
+    void    set_constants(pidval_t kp, pidval_t ki, pidval_t kd);
 
     // Call this to compute a new output value. 
-    pid_t   compute(pid_t pv, pid_t dt);
+    pidval_t compute(pidval_t pv, pidval_t dt);
 
 protected:
 
     // This is the measured value we are trying to maintain control of
-    pid_t   m_setpoint;
+    pidval_t m_setpoint;
 
     // This is the accumulated sum of errors
-    pid_t   m_integral;
+    pidval_t m_integral;
 
     // These are the tunable kP, kI, and kD constants
-    pid_t   m_kp, m_ki, m_kd;
+    pidval_t m_kp, m_ki, m_kd;
 
     // These are the limits on the output
-    pid_t   m_lower_limit, m_upper_limit;
+    pidval_t m_lower_limit, m_upper_limit;
 
     // This is the error saved from the most recent called to "compute()"
-    pid_t   m_previous_error;
+    pidval_t m_previous_error;
 
 };
 
@@ -202,6 +202,9 @@ void CRotaryKnob::init(int A_pin, int B_pin, int click_pin)
     // We haven't sensed any events yet
     m_event_count = 0;
 
+    // And we're not throwing any away
+    m_throw_away_next_event = false;
+
     // The index of the next event to be added or retrieved starts at zero
     m_put_index = m_get_index = 0;
 
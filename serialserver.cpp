@@ -3,8 +3,11 @@
 //=========================================================================================================
 #include "serialserver.h"
 #include <string.h>
+#include <stdlib.h>
 #include "globals.h"
+#include "common.h"
 #include "strfloat.h"
+#include "fast_sht31.h"
 
 // Compares a token to a string constant.  The string constant can be in RAM or Flash
 #define token_is(strcon) ((compare_token(token,strcon)))
@@ -28,6 +31,7 @@ void CSerialServer::on_command(const char* token)
     else if token_is("help")    handle_help();
     else if token_is("nvset")   handle_nvset();
     else if token_is("eeset")   handle_nvset();
+    else if token_is("temp")    handle_temp();
 
     else fail_syntax();
 }
@@ -167,6 +171,7 @@ bool CSerialServer::handle_help()
     const char line_06  [] PROGMEM = "eeset kp <value>  - Saves PID P constant to EEPROM";
     const char line_07  [] PROGMEM = "eeset ki <value>  - Saves PID I constant to EEPROM";
     const char line_08  [] PROGMEM = "eeset kd <value>  - Saves PID D constant to EEPROM";
+    const char line_09  [] PROGMEM = "temp [low|med|hi] - Reads the temperature/humidity sensor";
 
 
     replyf(line_01);
@@ -177,6 +182,7 @@ bool CSerialServer::handle_help()
     replyf(line_06);
     replyf(line_07);
     replyf(line_08);
+    replyf(line_09);
 
     return pass();
 }
@@ -188,6 +194,8 @@ bool CSerialServer::handle_help()
 //                    nvset kp <value>
 //                    nvset ki <value>
 //                    nvset kd <value>
+//
+// The value is saved in the background, so the knob, display, and PID loop keep running while it is
 //=========================================================================================================
 bool CSerialServer::handle_nvset()
 {
@@ -208,24 +216,24 @@ bool CSerialServer::handle_nvset()
     // Handle "nvset kp"
     if token_is("kp")
     {
-        ee.kp = fvalue;
-        EEPROM.write();
+        EEPROM.data.kp = fvalue;
+        EEPROM.write_async();
         return pass();
     }
 
     // Handle "nvset ki"
     if token_is("ki")
     {
-        ee.ki = fvalue;
-        EEPROM.write();
+        EEPROM.data.ki = fvalue;
+        EEPROM.write_async();
         return pass();
     }
 
     // Handle "nvset kd"
     if token_is("kd")
     {
-        ee.kd = fvalue;
-        EEPROM.write();
+        EEPROM.data.kd = fvalue;
+        EEPROM.write_async();
         return pass();
     }
 
@@ -234,3 +242,36 @@ bool CSerialServer::handle_nvset()
 }
 //=========================================================================================================
 
+
+
+//=========================================================================================================
+// handle_temp() - Handles these commands:
+//                    temp
+//                    temp low
+//                    temp med
+//                    temp hi
+//=========================================================================================================
+bool CSerialServer::handle_temp()
+{
+    const char* token;
+    sht31_rep_t repeatability = SHT31_MED;
+    float temp_c;
+    int   rh;
+
+    // If there's another token, it's the repeatability
+    if (get_next_token(&token))
+    {
+        if      token_is("low") repeatability = SHT31_LOW;
+        else if token_is("med") repeatability = SHT31_MED;
+        else if token_is("hi")  repeatability = SHT31_HIGH;
+        else return fail_syntax();
+    }
+
+    // Read the sensor
+    CFastSHT31 sensor(SHT31_I2C_ADDRESS, repeatability);
+    if (!sensor.read_c(&temp_c, &rh)) return fail("SENSOR");
+
+    // And report the temperature and humidity
+    return pass("%s %i", strfloat(temp_c, 0, 2), rh);
+}
+//=========================================================================================================
@@ -22,6 +22,7 @@ protected:
     bool    handle_nvset();
     bool    handle_reboot();
     bool    handle_help();
+    bool    handle_temp();
     // ------------------------------------------------------------------
 
     void    show_nv(void*);
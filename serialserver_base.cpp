@@ -1,4 +1,4 @@
-#include <arduino.h>
+#include <Arduino.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
@@ -39,6 +39,7 @@ void CSerialServerBase::reset()
 {
     // Reset the message pointer back to the beginning of the buffer
     m_input = m_message;
+    m_next_token = m_message;
 
     // And we now have the entire buffer free for incoming data
     m_free_remaining = sizeof(m_message) - 1;
@@ -47,6 +48,23 @@ void CSerialServerBase::reset()
 
 
 
+//=========================================================================================================
+// operator=() - Copies the state of another server.  m_input and m_next_token point into the message
+//               buffer, so they get re-pointed into ours
+//=========================================================================================================
+CSerialServerBase& CSerialServerBase::operator=(const CSerialServerBase& rhs)
+{
+    memcpy(m_message, rhs.m_message, sizeof(m_message));
+    m_input          = m_message + (rhs.m_input - rhs.m_message);
+    m_next_token     = m_message + (rhs.m_next_token - rhs.m_message);
+    m_free_remaining = rhs.m_free_remaining;
+    m_prefix         = rhs.m_prefix;
+    return *this;
+}
+//=========================================================================================================
+
+
+
 //=========================================================================================================
 // execute() - State machine: Call this often, or with blocking set to true
 // 
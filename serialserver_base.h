@@ -13,6 +13,10 @@ public:
     // Constructor
     CSerialServerBase() { reset(); }
 
+    // Copying a server copies any partially received message.  The copy's pointers refer to its own buffer
+    CSerialServerBase(const CSerialServerBase& rhs) { *this = rhs; }
+    CSerialServerBase& operator=(const CSerialServerBase& rhs);
+
     // Call this to throw away any partially recieved messages
     void    reset();
 
@@ -1,20 +1,20 @@
 // sim.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
 
-#include <Windows.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "int_thread.h"
-#include "arduino.h"
+#include "Arduino.h"
 #include "globals.h"
 #include "common.h"
 #include "eeprom_manager.h"
-#include "mstimer.h"
+#include "sim_device.h"
+#include "sim_runner.h"
 
 InterruptThread IntThread;
 
-CEEPROM NVS;
-
-const CEEPROM::data_t& ee = NVS.data;
+CSimRunner SimRunner;
 
 struct aa_t
 {
@@ -32,7 +32,7 @@ public:
     void    set_y(uint8_t value)  { set(data.y, value); }
     void    set_z(uint32_t value) { set(data.z, value); }
 
-    const aa_t data;
+    const aa_t data = { 0 };
 
 
 
@@ -52,130 +52,203 @@ protected:
 
 
 //=============================================================================================
-// map_led_to_pwm_reg() - Builds a map of which PWM register corresponds to each LED index
+// parse_command_line() - Configures the virtual clock from the command line
+//
+//     -fast         = Run as fast as possible, jumping straight to the next deadline when idle
+//     -scale <n>    = Run <n> times faster than real-time
+//     -run <secs>   = Stop after this many seconds of virtual time
+//     -s <file>     = Replay a stimulus trace instead of reading the keyboard.  "-" means stdin.
+//                     Unless -scale is given, a trace runs as fast as possible
+//     -n <count>    = Simulate this many independent devices (requires -s)
+//     -j <threads>  = Run the devices on this many worker threads (default: one per core)
+//     -boot <file>  = Run this trace once, then start every device from a snapshot of the result
+//     -display      = Draw the LED matrix at the top of the terminal (interactive mode only)
+//     -eesize <n>   = The size of the EEPROM, in bytes
+//     -eeflush <p>  = When EEPROM writes reach eeprom.bin: "write" (after every write), "exit" (only
+//                     at exit), or a number of milliseconds between flushes
+//     -eewrite <us> = How many microseconds of virtual time it takes to program an EEPROM byte
 //=============================================================================================
-int MAX_ROWS = 8;
-int MAX_COLS = 16;
-
-unsigned char pwm_reg[128];
-static void map_led_to_pwm_reg()
+static CSimRunner::clock_cfg_t clock_cfg = { CSimClock::REAL_TIME, 1.0, CSimClock::NO_LIMIT };
+static const char* trace_filename = nullptr;
+static const char* boot_filename = nullptr;
+static int device_count = 1;
+static int thread_count = 0;
+static bool is_display_drawn = false;
+static CSimEEPROM::config_t eeprom_cfg = CSimEEPROM::DEFAULT_CONFIG;
+
+static void parse_command_line(int argc, char** argv)
 {
-    int PWM_BASE_REG = 0x24;
+    bool mode_given = false;
 
-    int row, col;
-    int starting_reg_l = MAX_ROWS - 1;
-    int starting_reg_r = MAX_ROWS + 16 * 7;
-    int index = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
 
+        if (strcmp(arg, "-fast") == 0)
+        {
+            clock_cfg.mode = CSimClock::FAST;
+            mode_given = true;
+        }
 
-    // Loop through every row the chip supports
-    for (row = 0; row < MAX_ROWS; ++row)
-    {
-        // For the first 8 columns, register numbers are ascending
-        for (col = 0; col < MAX_COLS / 2; ++col)
+        else if (strcmp(arg, "-scale") == 0 && i + 1 < argc)
         {
-            pwm_reg[index++] = PWM_BASE_REG + starting_reg_l + col * 16;
+            clock_cfg.mode  = CSimClock::SCALED;
+            clock_cfg.scale = atof(argv[++i]);
+            mode_given = true;
         }
 
-        // For the next 8 columns, register numbers are descending
-        for (col = 0; col < MAX_COLS / 2; ++col)
+        else if (strcmp(arg, "-s") == 0 && i + 1 < argc)
+            trace_filename = argv[++i];
+
+        else if (strcmp(arg, "-boot") == 0 && i + 1 < argc)
+            boot_filename = argv[++i];
+
+        else if (strcmp(arg, "-n") == 0 && i + 1 < argc)
+            device_count = atoi(argv[++i]);
+
+        else if (strcmp(arg, "-j") == 0 && i + 1 < argc)
+            thread_count = atoi(argv[++i]);
+
+        else if (strcmp(arg, "-display") == 0)
+            is_display_drawn = true;
+
+        else if (strcmp(arg, "-eesize") == 0 && i + 1 < argc)
+            eeprom_cfg.size = strtoul(argv[++i], nullptr, 0);
+
+        else if (strcmp(arg, "-eewrite") == 0 && i + 1 < argc)
+            eeprom_cfg.program_us = strtoul(argv[++i], nullptr, 0);
+
+        else if (strcmp(arg, "-eeflush") == 0 && i + 1 < argc)
+        {
+            const char* policy = argv[++i];
+            if (strcmp(policy, "write") == 0)
+                eeprom_cfg.flush = CSimEEPROM::FLUSH_EACH_WRITE;
+            else if (strcmp(policy, "exit") == 0)
+                eeprom_cfg.flush = CSimEEPROM::FLUSH_ON_EXIT;
+            else
+            {
+                eeprom_cfg.flush = CSimEEPROM::FLUSH_PERIODIC;
+                eeprom_cfg.period_ms = atoi(policy);
+            }
+        }
+
+        else if (strcmp(arg, "-run") == 0 && i + 1 < argc)
+            clock_cfg.limit_us = (uint64_t)(atof(argv[++i]) * 1000000);
+
+        else
         {
-            pwm_reg[index++] = PWM_BASE_REG + starting_reg_r - col * 16;
+            printf("Unknown option \"%s\"\n", arg);
+            exit(1);
         }
+    }
 
-        --starting_reg_l;
-        ++starting_reg_r;
+    // Only a trace can drive more than one device, or start from a booted snapshot
+    if (device_count < 1 || ((device_count > 1 || boot_filename) && trace_filename == nullptr))
+    {
+        printf("-n and -boot require -s\n");
+        exit(1);
     }
+
+    // Batch runs go as fast as possible unless the user asked otherwise
+    if (trace_filename && !mode_given) clock_cfg.mode = CSimClock::FAST;
 }
 //=============================================================================================
 
 
-
-int main()
+//=============================================================================================
+// read_trace() - Reads an entire stimulus trace into memory.  "-" means stdin
+//=============================================================================================
+static std::string read_trace(const char* filename)
 {
-    map_led_to_pwm_reg();
+    bool is_stdin = strcmp(filename, "-") == 0;
+    std::string trace;
+    char buffer[4096];
+    size_t count;
 
-    unsigned char* in = pwm_reg;
-    for (int row = 0; row < MAX_ROWS; ++row)
+    FILE* ifile = is_stdin ? stdin : fopen(filename, "r");
+    if (ifile == nullptr)
     {
-        for (int col = 0; col < MAX_COLS; ++col)
-        {
-            printf("%3i, ", *in++);
-        }
-        printf("\n");
+        fprintf(stderr, "Can't open %s\n", filename);
+        exit(CSimStimulus::EXIT_BAD_TRACE);
     }
 
+    while ((count = fread(buffer, 1, sizeof buffer, ifile)) > 0) trace.append(buffer, count);
+
+    if (!is_stdin) fclose(ifile);
+    return trace;
+}
+//=============================================================================================
+
+
 
+int main(int argc, char** argv)
+{
+    parse_command_line(argc, argv);
+
+#if 0
     TEST.set_x(3);
     TEST.set_z(41);
 
     printf("%i  %i\n", TEST.data.x, TEST.data.z);
     exit(1);
+#endif
 
 #if 0
-    NVS.destroy();
+    EEPROM.destroy();
     exit(1);
 #endif
 
 #if 0
-    NVS.destroy();
-    NVS.read();
+    EEPROM.destroy();
+    EEPROM.read();
 
     for (int i = 0; i < 6; ++i)
     {
         int hex = i + 1;
-        ee.run_mode = (hex << 4) | hex;
-        NVS.write();
+        EEPROM.data.run_mode = (hex << 4) | hex;
+        EEPROM.write();
     }
 
     exit(0);
 
 #endif
 
-#if 1
-    NVS.read();
-    printf("%d\n", ee.run_mode);
+#if 0
+    EEPROM.read();
+    printf("%d\n", EEPROM.data.run_mode);
     exit(1);
 #endif
 
-    Knob.init(CHANNEL_A, CHANNEL_B, CLICK_PIN);
-    IntThread.spawn();
-
-
-    msTimer timer;
-    OneShot oneshot;
-
-    oneshot.start(2000);
-
-    while (true)
+    // Scripted runs can simulate any number of devices
+    if (trace_filename)
     {
-        knob_event_t event;
-
-        if (Knob.get_event(&event)) switch (event)
-        {
-            
-            case KNOB_UP:
-                printf("Button Up\n");
-                break;
-
-            case KNOB_LPRESS:
-                printf("Button LongPress\n");
-                break;
-
-            case KNOB_LEFT:
-                printf("Turn Left\n");
-                break;
-
-            case KNOB_RIGHT:
-                printf("Turn Right\n");
-                break;
-
-        }
-
-        Sleep(300);
-        if (timer.is_expired()) printf("Timer expired\n");
-        if (oneshot.is_expired()) printf("Oneshot expired\n");
+        SimRunner.set_eeprom_config(eeprom_cfg);
+        if (boot_filename) SimRunner.set_boot_trace(read_trace(boot_filename), boot_filename);
+        const char* name = strcmp(trace_filename, "-") == 0 ? "stdin" : trace_filename;
+        return SimRunner.run(device_count, thread_count, clock_cfg, read_trace(trace_filename), name);
     }
 
+    // Otherwise, a single device is driven from the keyboard
+    CSimDevice* device = new CSimDevice();
+    device->select();
+    device->eeprom.configure(eeprom_cfg);
+    device->eeprom.load("eeprom.bin");
+    device->clock.set_mode(clock_cfg.mode, clock_cfg.scale);
+    device->host = &SimHost;
+    for (int i = 0; i < LED_CHIPS; ++i) device->led_matrix[i].set_terminal(is_display_drawn, i);
+    IntThread.spawn(device);
+
+    // Where possible, host tools talk to the serial port through a pseudo-terminal
+    const char* pty_name = device->serial.open_pty();
+    if (pty_name) fprintf(stderr, "Serial port is %s\n", pty_name);
+
+    int status = device->run(clock_cfg.limit_us);
+
+    // If we drew the display, give the terminal its full scrolling region back
+    if (is_display_drawn) printf("\x1b[r");
+    fflush(stdout);
+
+    // Whatever the flush policy, every EEPROM write reaches the file before we go
+    device->eeprom.flush();
+    return status;
 }
-
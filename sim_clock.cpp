@@ -0,0 +1,200 @@
+//=========================================================================================================
+// sim_clock.cpp - Implements the virtual-time clock that sits behind millis() in the simulator
+//=========================================================================================================
+#include <chrono>
+#include <thread>
+#include "sim_clock.h"
+
+
+//=========================================================================================================
+// Constructor() - The clock starts out running in real-time at virtual time zero
+//=========================================================================================================
+CSimClock::CSimClock()
+{
+    m_mode      = REAL_TIME;
+    m_scale     = 1.0;
+    m_virtual   = 0;
+    m_wall_base = wall_micros();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// wall_micros() - Returns the host's monotonic wall-clock time in microseconds
+//=========================================================================================================
+uint64_t CSimClock::wall_micros()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// set_mode() - Selects REAL_TIME, SCALED, or FAST mode.  Virtual time never jumps when changing modes
+//=========================================================================================================
+void CSimClock::set_mode(mode_t mode, double scale)
+{
+    // Freeze the virtual time as of right now
+    m_virtual = micros();
+
+    // And from this moment on, virtual time is measured relative to this wall-clock moment
+    m_wall_base = wall_micros();
+
+    // Real-time mode is just scaled mode with a scale of 1
+    if (mode == REAL_TIME) scale = 1.0;
+
+    // A scale of zero or less makes no sense
+    if (scale <= 0) scale = 1.0;
+
+    m_mode  = mode;
+    m_scale = scale;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// micros() - Returns the current virtual time in microseconds
+//=========================================================================================================
+uint64_t CSimClock::micros()
+{
+    // In FAST mode, time only moves when we move it
+    if (m_mode == FAST) return m_virtual;
+
+    // Otherwise, virtual time moves in proportion to the wall clock
+    uint64_t elapsed = wall_micros() - m_wall_base;
+    return m_virtual + (uint64_t)(elapsed * m_scale);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// freeze() - Latches the current virtual time.  In FAST mode, there's nothing to latch
+//=========================================================================================================
+void CSimClock::freeze()
+{
+    m_virtual   = micros();
+    m_wall_base = wall_micros();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// thaw() - Resumes virtual time from the value that freeze() latched, measured from this moment on
+//=========================================================================================================
+void CSimClock::thaw()
+{
+    m_wall_base = wall_micros();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// advance() - Moves virtual time forward by the specified number of microseconds
+//=========================================================================================================
+void CSimClock::advance(uint64_t duration_us)
+{
+    m_virtual += duration_us;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// add_deadline() - Records a virtual timestamp at which something will become due
+//=========================================================================================================
+void CSimClock::add_deadline(uint64_t when_us)
+{
+    m_deadlines.push(when_us);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// purge_deadlines() - Throws away any deadline that has already been reached
+//=========================================================================================================
+void CSimClock::purge_deadlines(uint64_t now)
+{
+    while (!m_deadlines.empty() && m_deadlines.top() <= now) m_deadlines.pop();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// next_deadline() - Fetches the earliest deadline that hasn't yet been reached
+//
+// Returns: true if there is a pending deadline, otherwise false
+//=========================================================================================================
+bool CSimClock::next_deadline(uint64_t* p_when_us)
+{
+    // Throw away the deadlines that have already come and gone
+    purge_deadlines(micros());
+
+    // If there are no deadlines left, tell the caller
+    if (m_deadlines.empty()) return false;
+
+    // Hand the caller the earliest pending deadline
+    *p_when_us = m_deadlines.top();
+    return true;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// wall_delay() - Converts a virtual timestamp into a wall-clock delay from right now.  In FAST mode
+//                virtual time doesn't follow the wall clock, so nothing is ever worth waiting for
+//=========================================================================================================
+uint64_t CSimClock::wall_delay(uint64_t when_us)
+{
+    uint64_t now = micros();
+    if (m_mode == FAST || when_us <= now) return 0;
+    return (uint64_t)((when_us - now) / m_scale);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// idle() - Called when the simulation has nothing to do
+//
+// In FAST mode, virtual time jumps straight to the next deadline.
+//
+// In REAL_TIME and SCALED mode, we sleep until the next deadline, but never for longer than MAX_SLEEP_US
+// of wall-clock time so that the caller gets a chance to look for outside input
+//
+// Passed: limit_us = Virtual time will never be advanced beyond this point
+//
+// Returns: false if we're in FAST mode and there is nothing pending (i.e., time would stand still
+//          forever), otherwise true
+//=========================================================================================================
+bool CSimClock::idle(uint64_t limit_us)
+{
+    uint64_t target;
+
+    // What time is it now?
+    uint64_t now = micros();
+
+    // If there's no pending deadline, the limit is as far as we can go
+    if (!next_deadline(&target)) target = limit_us;
+
+    // Never go beyond the caller's limit
+    if (target > limit_us) target = limit_us;
+
+    // If we're in FAST mode, jump straight to the target time
+    if (m_mode == FAST)
+    {
+        if (target == NO_LIMIT) return false;
+        if (target > now) m_virtual = target;
+        return true;
+    }
+
+    // How long should we sleep, in wall-clock microseconds?
+    uint64_t sleep_us = MAX_SLEEP_US;
+    if (target != NO_LIMIT && wall_delay(target) < sleep_us) sleep_us = wall_delay(target);
+
+    // If the target time has already arrived, there's no need to sleep
+    if (target <= now) return true;
+
+    // Go to sleep until the target time arrives
+    std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+    return true;
+}
+//=========================================================================================================
@@ -0,0 +1,92 @@
+//=========================================================================================================
+// sim_clock.h - Defines the virtual-time clock that sits behind millis() in the simulator
+//
+// The clock can run in one of three modes:
+//
+//     REAL_TIME = Virtual time tracks the wall clock
+//     SCALED    = Virtual time runs at a multiple (10x, 100x, etc) of the wall clock
+//     FAST      = Virtual time only moves when something makes it move.  When the simulation is idle,
+//                 time jumps straight to the next pending deadline
+//
+// Anything that will become "due" at some point in the future (timers, scheduled stimulus, etc) should
+// register that moment via add_deadline() so that idle() knows where to jump (or how long to sleep)
+//=========================================================================================================
+#ifndef _SIM_CLOCK_H_
+#define _SIM_CLOCK_H_
+#include <stdint.h>
+#include <vector>
+#include <queue>
+#include <functional>
+
+class CSimClock
+{
+public:
+
+    // These are the modes the clock can run in
+    enum mode_t : char { REAL_TIME, SCALED, FAST };
+
+    // Constructor: the clock starts in real-time mode at virtual time zero
+    CSimClock();
+
+    // Selects the mode and (for SCALED mode) how many times faster than real-time the clock runs
+    void        set_mode(mode_t mode, double scale = 1.0);
+
+    // Returns the current mode
+    mode_t      get_mode() { return m_mode; }
+
+    // Returns the current virtual time in microseconds or milliseconds
+    uint64_t    micros();
+    unsigned long millis() { return (unsigned long)(micros() / 1000); }
+
+    // Latches the current virtual time so that the clock can be copied.  After a copy is made, thaw()
+    // the copy to resume virtual time from the latched value
+    void        freeze();
+    void        thaw();
+
+    // Moves virtual time forward.  This is how the simulator charges time for "slow" operations
+    void        advance(uint64_t duration_us);
+
+    // Registers a virtual timestamp (in microseconds) at which something will become due
+    void        add_deadline(uint64_t when_us);
+
+    // Fetches the earliest pending deadline.  Returns false if there isn't one
+    bool        next_deadline(uint64_t* p_when_us);
+
+    // Returns how many wall-clock microseconds remain until virtual time reaches "when_us"
+    uint64_t    wall_delay(uint64_t when_us);
+
+    // Call this when the simulation has nothing to do.  Either sleeps or jumps forward to the next
+    // deadline (but never past "limit_us").  Returns false if there is nothing pending at all.
+    bool        idle(uint64_t limit_us = NO_LIMIT);
+
+    // A "limit" for idle() that means "there is no limit"
+    static const uint64_t NO_LIMIT = UINT64_MAX;
+
+protected:
+
+    // Returns the wall-clock time in microseconds
+    uint64_t    wall_micros();
+
+    // Throws away deadlines that are already in the past
+    void        purge_deadlines(uint64_t now);
+
+    // The mode the clock is running in
+    mode_t      m_mode;
+
+    // In SCALED mode, how many virtual microseconds pass per wall-clock microsecond
+    double      m_scale;
+
+    // The virtual time at the moment "m_wall_base" was recorded (or simply "now" in FAST mode)
+    uint64_t    m_virtual;
+
+    // The wall-clock time that corresponds to "m_virtual"
+    uint64_t    m_wall_base;
+
+    // The longest we will ever sleep in a single call to idle() in the real-time modes
+    enum { MAX_SLEEP_US = 10000 };
+
+    // Pending deadlines, earliest first
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> m_deadlines;
+};
+
+#endif
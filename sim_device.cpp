@@ -0,0 +1,160 @@
+//=========================================================================================================
+// sim_device.cpp - Implements a single simulated device
+//=========================================================================================================
+#include <string.h>
+#include "sim_device.h"
+
+thread_local CSimDevice* sim_current_device;
+
+
+//=========================================================================================================
+// sim_regs() - The shim headers use this to find the current device's I/O registers
+//=========================================================================================================
+sim_regs_t& sim_regs() { return sim_device().regs; }
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Constructor() - A freshly built device is in its power-on state
+//=========================================================================================================
+CSimDevice::CSimDevice(const char* name) : name(name)
+{
+    // The firmware hasn't started yet
+    is_powered_up = false;
+    is_reboot_pending = false;
+
+    // Until told otherwise, we don't wait on any outside inputs
+    host = nullptr;
+
+    // Just like the real hardware, all of the I/O registers start out as zero
+    regs = sim_regs_t();
+
+    // And nothing is driving any of the pins
+    memset(pin_signal, 0, sizeof pin_signal);
+    memset(pin_driven, 0, sizeof pin_driven);
+
+    // Plug the peripherals into the I2C bus
+    wire.attach(CSimSHT31::DEFAULT_ADDRESS, &sht31);
+    for (int i = 0; i < LED_CHIPS; ++i) wire.attach(CSimIS31FL3731::DEFAULT_ADDRESS + i, &led_matrix[i]);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// select() - Makes this the device that the firmware on the calling thread talks to
+//=========================================================================================================
+void CSimDevice::select()
+{
+    sim_current_device = this;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// run() - Powers up the device and runs the host loop until the stimulus says we're done or we
+//         hit the time limit
+//=========================================================================================================
+int CSimDevice::run(uint64_t limit_us)
+{
+    // Everything from here on refers to this device
+    select();
+
+    // Power up the firmware, unless this device was restored from an already running one
+    if (!is_powered_up) sketch.setup();
+    is_powered_up = true;
+
+    while (clock.micros() < limit_us && !stimulus.is_finished())
+    {
+        // Fire any simulated pin-edges and interrupts that are due
+        scheduler.run_due();
+
+        // This is a safe point for delivering interrupts that were held off by cli()
+        irq.service();
+
+        // Give the sketch a turn, then see what it put on the display
+        sketch.loop();
+        for (auto& matrix : led_matrix) matrix.refresh();
+
+        // If the firmware asked for a reboot, start it over from setup()
+        if (is_reboot_pending)
+        {
+            reboot();
+            sketch.setup();
+            is_powered_up = true;
+        }
+
+        // Nothing else to do until the next deadline arrives (or, with a host loop, until some input does)
+        bool keep_going = host ? host->idle(clock, limit_us) : clock.idle(limit_us);
+        if (!keep_going) break;
+    }
+
+    // Tell the caller how the run went
+    return stimulus.exit_status();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// snapshot() - Captures the entire state of this device, virtual time included
+//=========================================================================================================
+CSimDevice* CSimDevice::snapshot()
+{
+    // Latch virtual time so the copy picks up exactly where we are now
+    clock.freeze();
+
+    // Copy everything
+    return new CSimDevice(*this);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// restore() - Puts this device back into a state captured by snapshot()
+//=========================================================================================================
+void CSimDevice::restore(const CSimDevice& snapshot)
+{
+    // We keep our own name
+    std::string my_name = name;
+
+    // Copy everything
+    *this = snapshot;
+    name = my_name;
+
+    // Virtual time resumes from the moment the snapshot was taken
+    clock.thaw();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// reboot() - Puts the chip and the firmware back into their power-on state.  Anything outside of the
+//            chip (virtual time, the stimulus, the pins being driven, the EEPROM contents and the serial
+//            line) carries on undisturbed
+//=========================================================================================================
+void CSimDevice::reboot()
+{
+    is_reboot_pending = false;
+    is_powered_up = false;
+
+    regs      = sim_regs_t();
+    irq       = CSimIrq();
+    wire      = CArduinoWire();
+    knob      = CRotaryKnob();
+    sleep_mgr = CSleepMgr();
+    nvs       = CEEPROM();
+    display   = decltype(display)();
+    pid       = CPIDController();
+    sketch    = CSketch();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// CSystem::reboot() - In the simulator, the firmware's reboot request is carried out by the run loop
+//                     once control returns to it
+//=========================================================================================================
+void CSystem::reboot()
+{
+    sim_device().is_reboot_pending = true;
+}
+//=========================================================================================================
@@ -0,0 +1,117 @@
+//=========================================================================================================
+// sim_device.h - Defines a single simulated device: the board, its peripherals, and its firmware
+//
+// Everything that would be a global on a real board (I/O registers, the virtual clock, the knob, the
+// EEPROM, etc) lives in a CSimDevice, so that a single process can simulate many devices at once.
+//
+// Each thread has a "current" device.  The firmware refers to the usual global names (Knob, Wire,
+// PORTB, and so on) and the macros below map those names onto the current device.  A device must
+// only ever be run by one thread at a time.
+//
+// A device can be copied.  snapshot() captures the complete state of a device (virtual time, pending
+// stimulus, registers, EEPROM, firmware state) and restore() puts a device back into that state, so
+// that many test variations can fork from a single, already booted device.
+//=========================================================================================================
+#ifndef _SIM_DEVICE_H_
+#define _SIM_DEVICE_H_
+#include <string>
+#include <Arduino.h>
+#include "sim_clock.h"
+#include "sim_sched.h"
+#include "sim_irq.h"
+#include "sim_stimulus.h"
+#include "sim_eeprom.h"
+#include "sim_host.h"
+#include "sim_sht31.h"
+#include "sim_is31fl3731.h"
+#include "eeprom_manager.h"
+#include "is31fl3731.h"
+#include "pid_ctrl.h"
+#include "globals.h"
+#include "sketch.h"
+
+class CSimDevice
+{
+public:
+
+    // Constructor.  "name" is used to tag this device's output when several devices are running
+    CSimDevice(const char* name = "");
+
+    // Copying a device copies all of its state.  The copy's peripherals stay attached to the copy's bus
+    CSimDevice(const CSimDevice& rhs) : CSimDevice(rhs.name.c_str()) { *this = rhs; }
+    CSimDevice& operator=(const CSimDevice& rhs) = default;
+
+    // Makes this the current device for the calling thread
+    void            select();
+
+    // Powers up the device (if it isn't already) and runs it until the stimulus ends or virtual time
+    // reaches "limit_us".  Returns the status the stimulus asked for (see CSimStimulus::exit_status())
+    int             run(uint64_t limit_us = CSimClock::NO_LIMIT);
+
+    // Captures the entire state of this device in a new device.  The caller owns the result
+    CSimDevice*     snapshot();
+
+    // Puts this device back into the state captured by snapshot().  Our name is left alone
+    void            restore(const CSimDevice& snapshot);
+
+    // Performs a soft reboot: the firmware and the chip start over, but virtual time, pending stimulus,
+    // the EEPROM and the serial port carry on, just as they would on real hardware
+    void            reboot();
+
+    // The name of this device.  Empty if this is the only device
+    std::string     name;
+
+    // True once the firmware's setup() has been run
+    bool            is_powered_up;
+
+    // True when the firmware has asked for a reboot.  The run loop performs it at the next safe point
+    bool            is_reboot_pending;
+
+    // If this isn't nullptr, the device waits in this host loop (and handles its inputs) when idle
+    CSimHost*       host;
+
+    // The simulation machinery
+    CSimClock       clock;
+    CSimScheduler   scheduler;
+    CSimIrq         irq;
+    CSimStimulus    stimulus;
+
+    // The hardware
+    sim_regs_t      regs;
+    int             pin_signal[256];
+    bool            pin_driven[256];
+    CArduinoWire    wire;
+    CArduinoSerial  serial;
+    CSimEEPROM      eeprom;
+
+    // The peripherals on the I2C bus
+    CSimSHT31       sht31;
+    CSimIS31FL3731  led_matrix[LED_CHIPS];
+
+    // The firmware
+    CRotaryKnob     knob;
+    CSleepMgr       sleep_mgr;
+    CSystem         system;
+    CEEPROM         nvs;
+    IS31FL3731<LED_GEOMETRY, LED_CHIPS> display;
+    CPIDController  pid;
+    CSketch         sketch;
+};
+
+// The current device for this thread
+extern thread_local CSimDevice* sim_current_device;
+inline CSimDevice& sim_device() { return *sim_current_device; }
+
+// These map the traditional global names onto the current device
+#define SimClock        (sim_device().clock)
+#define SimScheduler    (sim_device().scheduler)
+#define SimIrq          (sim_device().irq)
+#define SimStimulus     (sim_device().stimulus)
+#define SimEEPROM       (sim_device().eeprom)
+#define Knob            (sim_device().knob)
+#define SleepMgr        (sim_device().sleep_mgr)
+#define System          (sim_device().system)
+#define EEPROM          (sim_device().nvs)
+#define Display         (sim_device().display)
+
+#endif
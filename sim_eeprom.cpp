@@ -1,77 +1,463 @@
+//=========================================================================================================
+// sim_eeprom.cpp - Implements the simulated EEPROM
+//=========================================================================================================
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
-#define FILENAME "eeprom.bin"
+#include <chrono>
+#include "sim_device.h"
 
-class CSimEEPROM
-{
-public:
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Writes get flushed about once a second, so a stress test doesn't spend its time waiting on the disk.
+// An ATmega1284 takes 3.3 ms to program a byte
+const CSimEEPROM::config_t CSimEEPROM::DEFAULT_CONFIG = { DEFAULT_SIZE, FLUSH_PERIODIC, 1000, 3300 };
 
-    CSimEEPROM();
+// A blank EEPROM byte
+#define BLANK 0xFF
 
-    void    save();
 
-    unsigned char data[0x1000];
-} SimEEPROM;
+//=========================================================================================================
+// now_ms() - Returns the host's monotonic wall-clock time in milliseconds
+//=========================================================================================================
+static uint64_t now_ms()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+//=========================================================================================================
 
 
+//=========================================================================================================
+// Constructor() - A new EEPROM is blank, and lives in RAM
+//=========================================================================================================
 CSimEEPROM::CSimEEPROM()
 {
-    FILE* ifile;
+    m_config     = DEFAULT_CONFIG;
+    m_ram.assign(m_config.size, BLANK);
+    m_wear.assign(m_config.size, 0);
+    m_stats      = stats_t();
+    m_failures   = 0;
+    m_bit_flips  = 0;
+    m_is_ok      = true;
+    m_ready_us   = 0;
+    memset(m_api, 0, sizeof m_api);
+    memset(m_api_start_us, 0, sizeof m_api_start_us);
+    m_data       = m_ram.data();
+    m_fd         = -1;
+    m_is_dirty   = false;
+    m_flushed_ms = 0;
+}
+//=========================================================================================================
+
 
-    // Start our data block off blank
-    memset(data, 0xFF, sizeof data);
+//=========================================================================================================
+// Destructor() - Makes sure every write has reached the file
+//=========================================================================================================
+CSimEEPROM::~CSimEEPROM()
+{
+    close();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Copy constructor() - The copy starts out as a blank, RAM-only EEPROM and then takes on our contents
+//=========================================================================================================
+CSimEEPROM::CSimEEPROM(const CSimEEPROM& rhs) : CSimEEPROM()
+{
+    *this = rhs;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// operator=() - Takes on the configuration and the contents of another EEPROM, but never its file
+//=========================================================================================================
+CSimEEPROM& CSimEEPROM::operator=(const CSimEEPROM& rhs)
+{
+    if (this == &rhs) return *this;
 
-    // Open the file, and if we can't, complain
-    if (fopen_s(&ifile, FILENAME, "rb") != 0) return;
+    // If we were backed by a file, we're not anymore
+    close();
 
-    // Read in as much of the data as exists
-    fread(data, 1, sizeof data, ifile);
+    // Copy the other EEPROM's image into our RAM
+    m_config = rhs.m_config;
+    m_ram.assign(rhs.m_data, rhs.m_data + rhs.m_config.size);
+    m_data  = m_ram.data();
+    m_wear  = rhs.m_wear;
+    m_stats = rhs.m_stats;
 
-    // We now have all of our data from the EEPROM file
-    fclose(ifile);
+    // And the faults and timing
+    m_failures  = rhs.m_failures;
+    m_bit_flips = rhs.m_bit_flips;
+    m_is_ok     = rhs.m_is_ok;
+    m_ready_us  = rhs.m_ready_us;
+    memcpy(m_api, rhs.m_api, sizeof m_api);
+    memcpy(m_api_start_us, rhs.m_api_start_us, sizeof m_api_start_us);
+    return *this;
 }
+//=========================================================================================================
 
 
-void CSimEEPROM::save()
+//=========================================================================================================
+// configure() - Sets the device size and the flush policy
+//=========================================================================================================
+void CSimEEPROM::configure(const config_t& config)
 {
-    FILE* ofile;
+    size_t size = m_config.size;
+    m_config = config;
+
+    // A mapped file can't change size under us.  Otherwise, a device that grew has blank bytes at the end
+    if (m_fd >= 0)
+        m_config.size = size;
+    else
+    {
+        m_ram.resize(m_config.size, BLANK);
+        m_data = m_ram.data();
+    }
+
+    m_wear.resize(m_config.size, 0);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// load() - Maps the EEPROM image onto a file
+//=========================================================================================================
+void CSimEEPROM::load(const char* filename)
+{
+    size_t size = m_config.size;
+
+    // If we were already backed by a file, let go of it
+    close();
+
+#ifdef __linux__
+
+    // Open the file, creating it if need be, and if we can't, the EEPROM stays in RAM
+    int fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+
+    // If the file is shorter than the device, stretch it to fit
+    struct stat st;
+    if (fstat(fd, &st) < 0 || ((size_t)st.st_size < size && ftruncate(fd, size) < 0))
+    {
+        ::close(fd);
+        return;
+    }
+
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        ::close(fd);
+        return;
+    }
+
+    // Whatever the file didn't have is blank
+    m_data = (unsigned char*)map;
+    if ((size_t)st.st_size < size) memset(m_data + st.st_size, BLANK, size - st.st_size);
+    m_fd = fd;
+
+    // The RAM image is no longer needed
+    std::vector<unsigned char>().swap(m_ram);
+
+#else
 
-    // Open the file, and if we can't, complain
-    if (fopen_s(&ofile, FILENAME, "wb") != 0) return;
+    // Without mmap, read in as much of the data as exists, and flush() writes all of it back
+    FILE* ifile = fopen(filename, "rb");
+    if (ifile)
+    {
+        fread(m_data, 1, size, ifile);
+        fclose(ifile);
+    }
 
-    // Write all of our data out
-    fwrite(data, 1, sizeof data, ofile);
+#endif
 
-    // We now have all of our data from the EEPROM file
+    // From now on, writes get saved to this file
+    m_filename   = filename;
+    m_is_dirty   = false;
+    m_flushed_ms = now_ms();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// flush() - Pushes any unflushed writes out to the file
+//=========================================================================================================
+void CSimEEPROM::flush()
+{
+    // If there's nothing to write, or nowhere to write it, there's nothing to do
+    if (!m_is_dirty || m_filename.empty()) return;
+
+#ifdef __linux__
+    msync(m_data, m_config.size, MS_SYNC);
+#else
+    FILE* ofile = fopen(m_filename.c_str(), "wb");
+    if (ofile == nullptr) return;
+    fwrite(m_data, 1, m_config.size, ofile);
     fclose(ofile);
+#endif
+
+    m_is_dirty   = false;
+    m_flushed_ms = now_ms();
 }
+//=========================================================================================================
 
 
+//=========================================================================================================
+// close() - Flushes, then detaches the image from its file, keeping a copy of it in RAM
+//=========================================================================================================
+void CSimEEPROM::close()
+{
+    if (m_filename.empty()) return;
 
-void eeprom_update_block(const void* src, void* dest, size_t count)
+    flush();
+
+#ifdef __linux__
+    m_ram.assign(m_data, m_data + m_config.size);
+    munmap(m_data, m_config.size);
+    ::close(m_fd);
+    m_fd   = -1;
+    m_data = m_ram.data();
+#endif
+
+    m_filename.clear();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// written() - Carries out the flush policy after a write
+//=========================================================================================================
+void CSimEEPROM::written()
 {
-    unsigned int index = (unsigned int)dest;
-        
-    memcpy(SimEEPROM.data + index, src, count);
+    m_is_dirty = true;
+
+    switch (m_config.flush)
+    {
+        case FLUSH_EACH_WRITE:
+            flush();
+            break;
+
+        case FLUSH_PERIODIC:
+            if (now_ms() - m_flushed_ms >= m_config.period_ms) flush();
+            break;
 
-    SimEEPROM.save();
+        case FLUSH_ON_EXIT:
+            break;
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// clip() - Returns how many bytes of a block fall inside the device
+//=========================================================================================================
+size_t CSimEEPROM::clip(size_t address, size_t count) const
+{
+    if (address >= m_config.size) return 0;
+    return (count < m_config.size - address) ? count : m_config.size - address;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// is_ready() - Returns true when the chip has finished programming the last byte it was given
+//=========================================================================================================
+bool CSimEEPROM::is_ready()
+{
+    return SimClock.micros() >= m_ready_us;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// wait_until_ready() - Waits (in virtual time) for the chip to finish programming
+//=========================================================================================================
+void CSimEEPROM::wait_until_ready()
+{
+    if (!is_ready()) sim_wait(m_ready_us);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// check_failure() - Decides whether the call being made suffers an injected I/O failure
+//=========================================================================================================
+bool CSimEEPROM::check_failure()
+{
+    m_is_ok = (m_failures == 0);
+    if (!m_is_ok) --m_failures;
+    return !m_is_ok;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// program() - Programs a block of bytes, keeping track of which cells were worn by it, and blocks for as
+//             long as the real chip would take to program them
+//=========================================================================================================
+void CSimEEPROM::program(size_t address, const void* src, size_t count, bool is_update)
+{
+    const unsigned char* in = (const unsigned char*)src;
+    uint32_t programmed = 0;
+
+    count = clip(address, count);
+
+    // Like avr-libc, wait for the chip to finish whatever it was programming before starting
+    wait_until_ready();
+
+    // A failed write gets only partway through its block
+    size_t stop = check_failure() ? count / 2 : count;
+
+    for (size_t i = 0; i < stop; ++i, ++address)
+    {
+        // The real chip reads a byte back before an update, and leaves it alone if it's unchanged
+        if (is_update && m_data[address] == in[i]) continue;
+
+        m_data[address] = in[i];
+        ++programmed;
+
+        // An injected bit flip corrupts the byte as it's programmed
+        if (m_bit_flips > 0)
+        {
+            m_data[address] ^= 1 << (address % 8);
+            --m_bit_flips;
+        }
+
+        if (++m_wear[address] > m_stats.peak_wear)
+        {
+            m_stats.peak_wear    = m_wear[address];
+            m_stats.peak_address = (uint32_t)address;
+        }
+    }
+
+    ++m_stats.calls;
+    m_stats.last_programmed = programmed;
+    m_stats.last_skipped    = (uint32_t)stop - programmed;
+    m_stats.programmed     += m_stats.last_programmed;
+    m_stats.skipped        += m_stats.last_skipped;
+
+    // If nothing changed, there's nothing to flush
+    if (programmed == 0) return;
+    written();
+
+    // Each byte waits for the one before it, and we return as soon as the last one has started.  The
+    // firmware is stuck here until then, though interrupts carry on
+    uint64_t now = SimClock.micros();
+    m_ready_us = now + (uint64_t)programmed * m_config.program_us;
+    SimClock.add_deadline(m_ready_us);
+    if (programmed > 1) sim_wait(m_ready_us - m_config.program_us);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// write() - Programs a block of bytes, whether or not they already hold their value
+//=========================================================================================================
+void CSimEEPROM::write(size_t address, const void* src, size_t count)
+{
+    program(address, src, count, false);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// update() - Programs only those bytes of a block that don't already hold their value
+//=========================================================================================================
+void CSimEEPROM::update(size_t address, const void* src, size_t count)
+{
+    program(address, src, count, true);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// read() - Reads a block of bytes from the EEPROM.  Bytes past the end of the device read as blank
+//=========================================================================================================
+void CSimEEPROM::read(size_t address, void* dest, size_t count)
+{
+    // The chip can't be read while it's programming a byte
+    wait_until_ready();
+
+    // A failed read returns nothing but blank bytes
+    size_t fit = check_failure() ? 0 : clip(address, count);
+
+    memcpy(dest, m_data + address, fit);
+    memset((unsigned char*)dest + fit, BLANK, count - fit);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_api() - Times a CEEPROM_Base API call, from its start to its finish
+//=========================================================================================================
+void CSimEEPROM::on_api(int api, bool is_finished)
+{
+    if (api < 0 || api >= API_COUNT) return;
+
+    uint64_t now = SimClock.micros();
+
+    // When a call starts, just remember when
+    if (!is_finished)
+    {
+        m_api_start_us[api] = now;
+        return;
+    }
+
+    api_stats_t& stats = m_api[api];
+    uint32_t elapsed = (uint32_t)(now - m_api_start_us[api]);
+    ++stats.calls;
+    stats.total_us += elapsed;
+    stats.last_us   = elapsed;
+    if (elapsed > stats.peak_us) stats.peak_us = elapsed;
+}
+//=========================================================================================================
+
+
+
+void eeprom_update_block(const void* src, void* dest, size_t count)
+{
+    SimEEPROM.update((uintptr_t)dest, src, count);
 }
 
 
 void eeprom_write_byte(uint8_t* addr, uint8_t value)
 {
-    unsigned int index = (unsigned int)addr;
+    SimEEPROM.write((uintptr_t)addr, &value, 1);
+}
 
-    SimEEPROM.data[index] = value;
 
-    SimEEPROM.save();
+void eeprom_update_byte(uint8_t* addr, uint8_t value)
+{
+    SimEEPROM.update((uintptr_t)addr, &value, 1);
+}
+
+
+bool eeprom_is_ready()
+{
+    return SimEEPROM.is_ready();
 }
 
 
 void eeprom_read_block(void* dest, const void* src, size_t count)
 {
-    unsigned int index = (unsigned int)src;
+    SimEEPROM.read((uintptr_t)src, dest, count);
+}
+
+
+bool sim_eeprom_status()
+{
+    return SimEEPROM.status();
+}
 
-    memcpy(dest, SimEEPROM.data + index, count);
-}
\ No newline at end of file
+
+void sim_eeprom_api(int api, bool is_finished)
+{
+    SimEEPROM.on_api(api, is_finished);
+}
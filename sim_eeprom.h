@@ -0,0 +1,168 @@
+//=========================================================================================================
+// sim_eeprom.h - Defines the simulated EEPROM that sits behind the <avr/eeprom.h> routines
+//
+// The EEPROM image lives in RAM until load() is called.  From then on, the image is the backing file
+// itself, mapped into memory: a write lands in the file's pages directly, and the flush policy decides
+// how often those pages are pushed out to disk.  Where mapping isn't available, the image stays in RAM
+// and a flush rewrites the file.
+//
+// A copy of an EEPROM always lives in RAM.  Only the EEPROM that called load() ever touches the file.
+//
+// Programming a byte costs virtual time (about 3.3 ms per byte on an AVR).  Like the real chip, the
+// EEPROM is busy until the last byte it was given is finished: the block routines wait for each byte in
+// turn, while a single-byte update returns right away and the chip finishes on its own.
+//
+// Faults can be injected: a failed call reports an I/O error to the firmware (a failed write only
+// programs the first half of its block), and a bit flip corrupts a byte as it's programmed.  The time
+// the firmware spends inside each CEEPROM_Base API call is recorded.
+//=========================================================================================================
+#ifndef _SIM_EEPROM_H_
+#define _SIM_EEPROM_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CSimEEPROM
+{
+public:
+
+    // When writes get pushed out to the backing file
+    enum flush_t
+    {
+        FLUSH_EACH_WRITE,   // At the end of every eeprom_update_block() or eeprom_write_byte()
+        FLUSH_PERIODIC,     // After a write, once "period_ms" of wall-clock time has passed since the last flush
+        FLUSH_ON_EXIT       // Only when the EEPROM is closed
+    };
+
+    // The size of the device, the flush policy, and how long it takes to program a byte.  Reads take a
+    // few CPU cycles per byte, which we don't charge for
+    struct config_t { size_t size; flush_t flush; uint32_t period_ms; uint32_t program_us; };
+
+    // The ATmega1284's EEPROM
+    enum { DEFAULT_SIZE = 0x1000 };
+
+    // The configuration a new EEPROM starts out with
+    static const config_t DEFAULT_CONFIG;
+
+    CSimEEPROM();
+    ~CSimEEPROM();
+
+    // A copy gets its own RAM image, so that a snapshot never writes to the original's file
+    CSimEEPROM(const CSimEEPROM& rhs);
+    CSimEEPROM& operator=(const CSimEEPROM& rhs);
+
+    // Sets the size of the device and the flush policy.  Call this before load(): once the image is
+    // mapped onto a file, only the flush policy can change
+    void    configure(const config_t& config);
+
+    // Maps the EEPROM image onto a file.  A missing file is created blank, and a short file is extended
+    // with blank bytes.  From then on, every write goes to that file
+    void    load(const char* filename);
+
+    // Pushes any writes that haven't been flushed out to the file
+    void    flush();
+
+    // Flushes, and detaches the image from its file.  The image carries on in RAM
+    void    close();
+
+    // These do the work of the <avr/eeprom.h> routines.  write() programs every byte, update() only those
+    // whose value differs, just like eeprom_write_byte() and eeprom_update_block() on the real chip.
+    // Addresses past the end of the device are ignored
+    void    write(size_t address, const void* src, size_t count);
+    void    update(size_t address, const void* src, size_t count);
+    void    read(size_t address, void* dest, size_t count);
+
+    // Wear counters, for measuring how hard the firmware works each cell
+    struct stats_t
+    {
+        uint32_t calls;                             // Calls to write() and update()
+        uint32_t programmed, skipped;               // Bytes, over every call
+        uint32_t last_programmed, last_skipped;     // What the most recent call did
+        uint32_t peak_wear, peak_address;           // The most-programmed byte, and how often it was
+    };
+    const stats_t& get_stats() const {return m_stats;}
+
+    // How many times the byte at "address" has been programmed
+    uint32_t wear(size_t address) const {return address < m_wear.size() ? m_wear[address] : 0;}
+
+    // Makes the next "count" calls to write(), update(), or read() fail
+    void    inject_failures(int count) {m_failures = count;}
+
+    // Flips a bit in each of the next "count" bytes to be programmed
+    void    inject_bit_flips(int count) {m_bit_flips = count;}
+
+    // Returns false if the most recent call failed
+    bool    status() const {return m_is_ok;}
+
+    // Returns true when the chip isn't busy programming a byte
+    bool    is_ready();
+
+    // The time spent in each CEEPROM_Base API call (see CEEPROM_Base::api_t)
+    enum { API_COUNT = 5 };
+    struct api_stats_t
+    {
+        uint32_t calls;
+        uint64_t total_us;                          // Over every call
+        uint32_t last_us, peak_us;                  // The most recent call, and the slowest
+    };
+    const api_stats_t& get_api_stats(int api) const {return m_api[api];}
+
+    // Called as an API call starts and finishes
+    void    on_api(int api, bool is_finished);
+
+    // The size of the device, in bytes
+    size_t  size() const {return m_config.size;}
+
+protected:
+
+    // Programs a block of bytes.  When "is_update" is true, bytes that already hold their value are skipped
+    void    program(size_t address, const void* src, size_t count, bool is_update);
+
+    // Called after each write to carry out the flush policy
+    void    written();
+
+    // Decides whether the call being made fails
+    bool    check_failure();
+
+    // Waits for the chip to finish programming
+    void    wait_until_ready();
+
+    // Clips a block to the end of the device.  Returns the number of bytes that fit
+    size_t  clip(size_t address, size_t count) const;
+
+    // How big the device is, and how writes are flushed
+    config_t            m_config;
+
+    // The image.  This points either at m_ram or at the mapped file
+    unsigned char*      m_data;
+
+    // The image, when it isn't mapped onto a file
+    std::vector<unsigned char> m_ram;
+
+    // How many times each byte has been programmed
+    std::vector<uint32_t> m_wear;
+    stats_t             m_stats;
+
+    // Injected faults that are still to come, and whether the most recent call succeeded
+    int                 m_failures;
+    int                 m_bit_flips;
+    bool                m_is_ok;
+
+    // The virtual time at which the chip finishes programming
+    uint64_t            m_ready_us;
+
+    // API timing, and the virtual time at which each API call in progress started
+    api_stats_t         m_api[API_COUNT];
+    uint64_t            m_api_start_us[API_COUNT];
+
+    // The file that backs the EEPROM image (empty if the image only lives in RAM) and its descriptor
+    std::string         m_filename;
+    int                 m_fd;
+
+    // True when there are writes that haven't been flushed, and the wall-clock time of the last flush
+    bool                m_is_dirty;
+    uint64_t            m_flushed_ms;
+};
+
+#endif
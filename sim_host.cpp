@@ -0,0 +1,217 @@
+//=========================================================================================================
+// sim_host.cpp - Implements the host event loop
+//=========================================================================================================
+#include <stdlib.h>
+#include "sim_host.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
+CSimHost SimHost;
+
+// The most events we'll pick up from a single call to epoll_wait()
+#define MAX_EVENTS 16
+
+
+#ifdef __linux__
+
+//=========================================================================================================
+// Constructor() - Creates the epoll set, with the deadline timer already in it
+//=========================================================================================================
+CSimHost::CSimHost()
+{
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = m_timer_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &event);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Destructor() - Closes our file descriptors
+//=========================================================================================================
+CSimHost::~CSimHost()
+{
+    close(m_timer_fd);
+    close(m_epoll_fd);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// add_fd() - Adds a file descriptor to the set we wait on
+//=========================================================================================================
+bool CSimHost::add_fd(int fd, handler_t handler, void* context)
+{
+    epoll_event event = {};
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
+
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) return false;
+
+    m_sources.push_back({ fd, handler, context });
+    return true;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// remove_fd() - Stops waiting on a file descriptor.  Safe to call from inside that fd's handler
+//=========================================================================================================
+void CSimHost::remove_fd(int fd)
+{
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+
+    for (auto it = m_sources.begin(); it != m_sources.end(); ++it)
+    {
+        if (it->fd == fd)
+        {
+            m_sources.erase(it);
+            return;
+        }
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// raw_console() - If stdin is a terminal, turns off line-buffering and echo so that every keystroke
+//                 is delivered as soon as it's typed.  The terminal is restored when the program exits
+//=========================================================================================================
+static termios original_termios;
+
+static void restore_console()
+{
+    tcsetattr(STDIN_FILENO, TCSANOW, &original_termios);
+}
+
+void CSimHost::raw_console()
+{
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &original_termios) != 0) return;
+
+    termios raw = original_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN]  = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+
+    atexit(restore_console);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// arm_timer() - Arms the deadline timer to expire after the given number of wall-clock microseconds
+//=========================================================================================================
+void CSimHost::arm_timer(uint64_t wall_us)
+{
+    itimerspec spec = {};
+
+    // An all-zero expiration would disarm the timer, so "right now" means one nanosecond from now
+    spec.it_value.tv_sec  = wall_us / 1000000;
+    spec.it_value.tv_nsec = (wall_us % 1000000) * 1000;
+    if (wall_us == 0) spec.it_value.tv_nsec = 1;
+
+    timerfd_settime(m_timer_fd, 0, &spec, nullptr);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// dispatch() - Waits for the epoll set, then calls the handler of every source that's ready
+//=========================================================================================================
+void CSimHost::dispatch(int timeout_ms)
+{
+    epoll_event events[MAX_EVENTS];
+    uint64_t    count;
+
+    int ready = epoll_wait(m_epoll_fd, events, MAX_EVENTS, timeout_ms);
+
+    for (int i = 0; i < ready; ++i)
+    {
+        int fd = events[i].data.fd;
+
+        // The timer just needs to be drained
+        if (fd == m_timer_fd)
+        {
+            if (read(fd, &count, sizeof count)) {}
+            continue;
+        }
+
+        // Find the handler for this source.  (It may have been removed by an earlier handler)
+        for (auto& source : m_sources) if (source.fd == fd)
+        {
+            source.handler(fd, source.context);
+            break;
+        }
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// idle() - Waits for input or for the next deadline
+//
+// In FAST mode we never wait for a deadline: we pick up any input that's already waiting, then let the
+// clock jump ahead.  If there's no deadline to jump to, time stands still until some input arrives
+//=========================================================================================================
+bool CSimHost::idle(CSimClock& clock, uint64_t limit_us)
+{
+    uint64_t target;
+
+    // In FAST mode, time doesn't wait for anything
+    if (clock.get_mode() == CSimClock::FAST)
+    {
+        dispatch(0);
+        if (clock.idle(limit_us)) return true;
+        if (m_sources.empty()) return false;
+        dispatch(-1);
+        return true;
+    }
+
+    // When is the next thing due?
+    if (!clock.next_deadline(&target) || target > limit_us) target = limit_us;
+
+    // If nothing is ever going to be due and there's no input to wait for, we'd wait forever
+    if (target == CSimClock::NO_LIMIT && m_sources.empty()) return false;
+
+    // Arm the timer for the deadline (or disarm it if there is no deadline)
+    if (target == CSimClock::NO_LIMIT)
+    {
+        itimerspec never = {};
+        timerfd_settime(m_timer_fd, 0, &never, nullptr);
+    }
+    else arm_timer(clock.wall_delay(target));
+
+    // And wait for something to happen
+    dispatch(-1);
+    return true;
+}
+//=========================================================================================================
+
+
+#else
+
+
+//=========================================================================================================
+// Without epoll, there are no sources to wait on and idle() simply lets the clock sleep
+//=========================================================================================================
+CSimHost::CSimHost()  { m_epoll_fd = m_timer_fd = -1; }
+CSimHost::~CSimHost() {}
+bool CSimHost::add_fd(int fd, handler_t handler, void* context) { return false; }
+void CSimHost::remove_fd(int fd) {}
+void CSimHost::raw_console() {}
+void CSimHost::dispatch(int timeout_ms) {}
+void CSimHost::arm_timer(uint64_t wall_us) {}
+bool CSimHost::idle(CSimClock& clock, uint64_t limit_us) { return clock.idle(limit_us); }
+//=========================================================================================================
+
+#endif
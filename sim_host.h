@@ -0,0 +1,60 @@
+//=========================================================================================================
+// sim_host.h - Defines the host event loop that the simulator waits in when it has nothing to do
+//
+// On Linux, every source of outside input (the keyboard, pseudo-terminals, sockets, etc) is registered
+// with add_fd(), and the next virtual-time deadline is armed on a timerfd.  idle() then blocks in a
+// single epoll_wait() until either an input is ready or the deadline arrives, so the simulator reacts
+// to input immediately and uses no CPU at all while it waits.
+//
+// Elsewhere (i.e., Windows), idle() simply defers to CSimClock::idle()
+//=========================================================================================================
+#ifndef _SIM_HOST_H_
+#define _SIM_HOST_H_
+#include <stdint.h>
+#include <vector>
+#include "sim_clock.h"
+
+class CSimHost
+{
+public:
+
+    // The routine that gets called when a file descriptor is ready to be read
+    typedef void (*handler_t)(int fd, void* context);
+
+    // Constructor and destructor
+    CSimHost();
+    ~CSimHost();
+
+    // Adds a file descriptor to the set we wait on.  "handler" gets called when "fd" is readable
+    bool    add_fd(int fd, handler_t handler, void* context = nullptr);
+
+    // Stops waiting on a file descriptor
+    void    remove_fd(int fd);
+
+    // Puts the console into "one key at a time" mode (if stdin is a terminal) until the program exits
+    void    raw_console();
+
+    // Waits until an input source is ready or the clock's next deadline (but never past "limit_us")
+    // arrives, and calls the handler for every input that is ready.  Returns false if there is nothing
+    // left that could ever wake us up
+    bool    idle(CSimClock& clock, uint64_t limit_us = CSimClock::NO_LIMIT);
+
+protected:
+
+    // Calls the handler for every source that is ready.  "timeout_ms" is as for epoll_wait()
+    void    dispatch(int timeout_ms);
+
+    // Arms the timer to go off after the given number of wall-clock microseconds
+    void    arm_timer(uint64_t wall_us);
+
+    // The sources we're waiting on
+    struct source_t { int fd; handler_t handler; void* context; };
+    std::vector<source_t> m_sources;
+
+    // The epoll set and the deadline timer
+    int     m_epoll_fd, m_timer_fd;
+};
+
+extern CSimHost SimHost;
+
+#endif
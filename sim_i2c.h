@@ -0,0 +1,30 @@
+//=========================================================================================================
+// sim_i2c.h - Defines the interface that a simulated I2C peripheral implements
+//
+// A device model is attached to the bus with Wire.attach(address, &model).  From then on, every
+// transaction addressed to it arrives as a series of calls:
+//
+//     on_start()      = A START (or repeated START) addressed to us.  Return false to NACK the address
+//     on_stretch()    = After we ACK a read: how many microseconds we hold SCL low before the first byte
+//     on_write()      = A byte written by the master.  Return false to NACK it
+//     on_read()       = The master wants the next byte
+//     on_stop()       = A STOP, or a repeated START addressed to someone else
+//=========================================================================================================
+#ifndef _SIM_I2C_H_
+#define _SIM_I2C_H_
+#include <stdint.h>
+
+class CSimI2CDevice
+{
+public:
+
+    virtual ~CSimI2CDevice() {}
+
+    virtual bool     on_start(bool) { return true; }
+    virtual uint32_t on_stretch() { return 0; }
+    virtual bool     on_write(uint8_t data) = 0;
+    virtual uint8_t  on_read() { return 0xFF; }
+    virtual void     on_stop() {}
+};
+
+#endif
@@ -0,0 +1,176 @@
+//=========================================================================================================
+// sim_irq.cpp - Implements the simulated AVR interrupt controller
+//=========================================================================================================
+#include <string.h>
+#include <Arduino.h>
+#include "sim_device.h"
+
+// The vector table as it's laid out in flash.  This is filled in by the ISR() macro during static
+// initialization, so it must not depend on any constructor having run.  Each device gets a copy
+static void (*vector_table[SIM_VECTOR_COUNT])();
+
+
+//=========================================================================================================
+// sim_register_isr() - Places an ISR into the vector table.  Called by the ISR() macro
+//=========================================================================================================
+bool sim_register_isr(int vector, void (*isr)())
+{
+    if (vector < 0 || vector >= SIM_VECTOR_COUNT) return false;
+    vector_table[vector] = isr;
+    return true;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Constructor() - Interrupts start out globally enabled, with the vector table as the firmware declared it
+//=========================================================================================================
+CSimIrq::CSimIrq()
+{
+    m_i_flag  = true;
+    m_pending = 0;
+    memcpy(m_vector, vector_table, sizeof m_vector);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// attach() - Installs a handler at run-time (i.e., attachInterrupt)
+//=========================================================================================================
+void CSimIrq::attach(int vector, void (*isr)())
+{
+    if (vector > 0 && vector < SIM_VECTOR_COUNT) m_vector[vector] = isr;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// raise() - Marks an interrupt vector as pending.  Just like the hardware, the flag gets set whether
+//           or not the vector is enabled
+//=========================================================================================================
+void CSimIrq::raise(int vector)
+{
+    // External interrupts INT0 thru INT2 latch in EIFR
+    if (vector >= INT0_vect_num && vector <= INT2_vect_num)
+    {
+        EIFR.set(1 << (vector - INT0_vect_num));
+        return;
+    }
+
+    // Pin-change interrupts PCINT0 thru PCINT3 latch in PCIFR
+    if (vector >= PCINT0_vect_num && vector <= PCINT3_vect_num)
+    {
+        PCIFR.set(1 << (vector - PCINT0_vect_num));
+        return;
+    }
+
+    // Everything else latches in our own pending flags
+    if (vector > 0 && vector < SIM_VECTOR_COUNT) m_pending |= (1UL << vector);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// acknowledge() - Clears the pending flag for a vector, just as the hardware does on entry to the ISR
+//=========================================================================================================
+void CSimIrq::acknowledge(int vector)
+{
+    if (vector >= INT0_vect_num && vector <= INT2_vect_num)
+        EIFR |= (1 << (vector - INT0_vect_num));
+
+    else if (vector >= PCINT0_vect_num && vector <= PCINT3_vect_num)
+        PCIFR |= (1 << (vector - PCINT0_vect_num));
+
+    else
+        m_pending &= ~(1UL << vector);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// find_deliverable() - Returns the highest priority vector that is both pending and enabled
+//
+// Returns: A vector number, or -1 if no vector is ready to be delivered
+//=========================================================================================================
+int CSimIrq::find_deliverable()
+{
+    // Lower vector numbers have higher priority
+    for (int vector = 1; vector < SIM_VECTOR_COUNT; ++vector)
+    {
+        bool pending, enabled;
+
+        if (vector >= INT0_vect_num && vector <= INT2_vect_num)
+        {
+            int bit = 1 << (vector - INT0_vect_num);
+            pending = (EIFR & bit) != 0;
+            enabled = (EIMSK & bit) != 0;
+        }
+
+        else if (vector >= PCINT0_vect_num && vector <= PCINT3_vect_num)
+        {
+            int bit = 1 << (vector - PCINT0_vect_num);
+            pending = (PCIFR & bit) != 0;
+            enabled = (PCICR & bit) != 0;
+        }
+
+        else if (vector == EE_READY_vect_num)
+        {
+            pending = sim_device().eeprom.is_ready();
+            enabled = (EECR & (1 << EERIE)) != 0;
+        }
+
+        else
+        {
+            pending = (m_pending & (1UL << vector)) != 0;
+            enabled = true;
+        }
+
+        if (pending && enabled) return vector;
+    }
+
+    // If we get here, there's nothing to deliver
+    return -1;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// service() - Delivers every pending, enabled interrupt in priority order
+//
+// Just like the hardware, interrupts are globally disabled while an ISR runs and are re-enabled by the
+// (simulated) RETI when it returns
+//=========================================================================================================
+void CSimIrq::service()
+{
+    while (m_i_flag)
+    {
+        // Find the highest priority interrupt that's ready to go
+        int vector = find_deliverable();
+
+        // If there isn't one, we're done
+        if (vector < 0) return;
+
+        // The hardware clears the flag on entry to the ISR
+        acknowledge(vector);
+
+        // If nobody has installed an ISR for this vector, ignore it
+        if (m_vector[vector] == nullptr) continue;
+
+        // Entering an ISR clears the I-flag, and RETI sets it again
+        m_i_flag = false;
+        m_vector[vector]();
+        m_i_flag = true;
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// sei() - Globally enables interrupts and delivers any that were latched while they were disabled
+//=========================================================================================================
+void CSimIrq::sei()
+{
+    m_i_flag = true;
+    service();
+}
+//=========================================================================================================
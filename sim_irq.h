@@ -0,0 +1,62 @@
+//=========================================================================================================
+// sim_irq.h - Defines the simulated AVR interrupt controller
+//
+// This models the single-core AVR interrupt scheme:
+//
+//     - A global interrupt-enable flag (the I-bit in SREG) controlled by cli() and sei()
+//     - Per-vector enable bits (EIMSK for INTn, PCICR for PCINTn, EERIE in EECR for EE_READY)
+//     - Per-vector pending flags (EIFR for INTn, PCIFR for PCINTn) that latch while interrupts are
+//       masked and are cleared when the ISR is entered.  EE_READY has no flag: like the hardware, it
+//       stays pending for as long as the EEPROM is ready
+//
+// ISRs are only ever delivered on the simulation thread, at "safe points": when sei() is called, and
+// whenever the host loop calls service().  Lower numbered vectors have higher priority, just like on
+// the real hardware.
+//=========================================================================================================
+#ifndef _SIM_IRQ_H_
+#define _SIM_IRQ_H_
+#include <stdint.h>
+#include <Arduino.h>
+
+class CSimIrq
+{
+public:
+
+    // Constructor.  Like the Arduino core, we start with interrupts globally enabled
+    CSimIrq();
+
+    // Installs (or with nullptr, removes) the handler for a vector in this device's vector table
+    void    attach(int vector, void (*isr)());
+
+    // Marks an interrupt vector as pending
+    void    raise(int vector);
+
+    // Delivers every pending and enabled interrupt, provided interrupts are globally enabled
+    void    service();
+
+    // These are the simulated "cli" and "sei" instructions
+    void    cli() { m_i_flag = false; }
+    void    sei();
+
+    // Returns true if interrupts are globally enabled
+    bool    is_enabled() { return m_i_flag; }
+
+protected:
+
+    // Returns the highest priority interrupt that is both pending and enabled, or -1 if there isn't one
+    int     find_deliverable();
+
+    // Clears the pending flag for a vector (the hardware does this on entry to the ISR)
+    void    acknowledge(int vector);
+
+    // The global interrupt enable flag (the I-bit in SREG)
+    bool    m_i_flag;
+
+    // Pending flags for vectors that don't have a flag register of their own
+    uint32_t m_pending;
+
+    // This device's vector table.  It starts out as a copy of the handlers declared with ISR()
+    void    (*m_vector[SIM_VECTOR_COUNT])();
+};
+
+#endif
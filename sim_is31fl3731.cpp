@@ -0,0 +1,235 @@
+//=========================================================================================================
+// sim_is31fl3731.cpp - Implements a register-level model of the ISSI IS31FL3731 LED matrix driver
+//=========================================================================================================
+#include <stdio.h>
+#include <string.h>
+#include "sim_device.h"
+#include "sim_is31fl3731.h"
+
+// The terminal line that the first row of the matrix is drawn on.  Line 1 is the top border
+#define FIRST_ROW_LINE  2
+
+// Simulator output scrolls in the region below the matrix and its borders
+#define SCROLL_TOP_LINE (FIRST_ROW_LINE + CSimIS31FL3731::ROWS + 2)
+
+
+//=========================================================================================================
+// Constructor() - Every register powers up as zero, which means the chip starts out shut down
+//=========================================================================================================
+CSimIS31FL3731::CSimIS31FL3731()
+{
+    memset(m_frame, 0, sizeof m_frame);
+    memset(m_function, 0, sizeof m_function);
+    memset(m_image, 0, sizeof m_image);
+    memset(m_drawn, 0, sizeof m_drawn);
+    memset(&m_stats, 0, sizeof m_stats);
+    m_page = 0;
+    m_pointer = 0;
+    m_is_address_next = true;
+    m_autoplay_us = 0;
+    m_pending_bytes = m_pending_transactions = 0;
+    m_is_drawing = m_is_screen_ready = false;
+    m_first_col = 1;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// reg() - Returns a pointer to a register on the selected page
+//=========================================================================================================
+uint8_t* CSimIS31FL3731::reg(uint8_t address)
+{
+    if (m_page == FUNCTION_PAGE) return (address < FUNCTION_SIZE) ? &m_function[address] : nullptr;
+    return (address < FRAME_SIZE) ? &m_frame[m_page][address] : nullptr;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_start() - Every transaction we answer counts toward the cost of the next displayed frame
+//=========================================================================================================
+bool CSimIS31FL3731::on_start(bool is_read)
+{
+    ++m_pending_transactions;
+
+    // The first byte of a write is always a register address
+    if (!is_read) m_is_address_next = true;
+    return true;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_write() - The first byte selects a register.  Subsequent bytes are written to consecutive registers
+//=========================================================================================================
+bool CSimIS31FL3731::on_write(uint8_t data)
+{
+    ++m_pending_bytes;
+
+    if (m_is_address_next)
+    {
+        m_pointer = data;
+        m_is_address_next = false;
+        return true;
+    }
+
+    // The command register selects a page, and exists no matter which page is selected
+    if (m_pointer == COMMAND_REG)
+    {
+        if (data < FRAME_COUNT || data == FUNCTION_PAGE) m_page = data;
+        return true;
+    }
+
+    // Writing the configuration register (re)starts auto-play
+    if (m_page == FUNCTION_PAGE && m_pointer == CONFIG_REG) m_autoplay_us = SimClock.micros();
+
+    // Write the register and move to the next one
+    uint8_t* p = reg(m_pointer++);
+    if (p) *p = data;
+    return true;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_read() - Returns consecutive registers, starting at the one most recently selected
+//=========================================================================================================
+uint8_t CSimIS31FL3731::on_read()
+{
+    ++m_pending_bytes;
+
+    if (m_pointer == COMMAND_REG) return m_page;
+    uint8_t* p = reg(m_pointer++);
+    return p ? *p : 0;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// autoplay_frame() - Auto-play shows "count" frames, starting at the start frame, for one frame-delay
+//                    apiece.  After the programmed number of loops (0 = forever), the last frame stays
+//=========================================================================================================
+int CSimIS31FL3731::autoplay_frame()
+{
+    int first = m_function[CONFIG_REG] & 7;
+    int count = m_function[AUTOPLAY1_REG] & 7;
+    int loops = (m_function[AUTOPLAY1_REG] >> 4) & 7;
+    int ticks = m_function[AUTOPLAY2_REG] & 63;
+
+    // A count of 0 means all 8 frames, and a delay of 0 means 64 ticks
+    if (count == 0) count = 8;
+    if (ticks == 0) ticks = 64;
+
+    // How many frame-steps have happened since auto-play started?
+    uint64_t frame_us = (uint64_t)ticks * AUTOPLAY_TICK_US;
+    uint64_t step = (SimClock.micros() - m_autoplay_us) / frame_us;
+
+    // If it's still playing, make sure we get a look at the next frame when it arrives
+    if (loops && step >= (uint64_t)(loops * count))
+        step = loops * count - 1;
+    else
+        SimClock.add_deadline(m_autoplay_us + (step + 1) * frame_us);
+
+    return (first + step % count) & 7;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// compute_image() - Computes what the matrix is showing right now
+//=========================================================================================================
+void CSimIS31FL3731::compute_image(uint8_t image[ROWS][COLS])
+{
+    // In shutdown, everything is dark
+    if ((m_function[SHUTDOWN_REG] & 1) == 0)
+    {
+        memset(image, 0, ROWS * COLS);
+        return;
+    }
+
+    // Which frame is being displayed?  In auto-play mode, the chip decides
+    bool is_autoplay = ((m_function[CONFIG_REG] >> 3) & 3) == 1;
+    const uint8_t* frame = m_frame[is_autoplay ? autoplay_frame() : (m_function[PICTURE_REG] & 7)];
+
+    // An LED shows its PWM value if its control bit is on
+    for (int row = 0; row < ROWS; ++row) for (int col = 0; col < COLS; ++col)
+    {
+        int led = led_map<LED_GEOMETRY>::table[row * COLS + col];
+        bool is_on = (frame[LED_CTRL_REG + led / 8] >> (led % 8)) & 1;
+        image[row][col] = is_on ? frame[PWM_REG + led] : 0;
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// pixel() - Returns the brightness of one LED of the image most recently displayed
+//=========================================================================================================
+uint8_t CSimIS31FL3731::pixel(int row, int col)
+{
+    if (row < 0 || row >= ROWS || col < 0 || col >= COLS) return 0;
+    return m_image[row][col];
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// refresh() - If the visible image has changed, that's a new displayed frame.  Records what it cost
+//=========================================================================================================
+void CSimIS31FL3731::refresh()
+{
+    uint8_t image[ROWS][COLS];
+
+    // If nothing visible has changed, there's no new frame
+    compute_image(image);
+    if (memcmp(image, m_image, sizeof image) == 0) return;
+    memcpy(m_image, image, sizeof image);
+
+    // Charge this frame for all the traffic since the previous one
+    ++m_stats.frames;
+    m_stats.bytes             += m_pending_bytes;
+    m_stats.transactions      += m_pending_transactions;
+    m_stats.last_bytes         = m_pending_bytes;
+    m_stats.last_transactions  = m_pending_transactions;
+    if (m_pending_bytes        > m_stats.peak_bytes)        m_stats.peak_bytes        = m_pending_bytes;
+    if (m_pending_transactions > m_stats.peak_transactions) m_stats.peak_transactions = m_pending_transactions;
+    m_pending_bytes = m_pending_transactions = 0;
+
+    if (m_is_drawing) draw();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// draw() - Draws the matrix at the top of the terminal.  Only the cells that changed get redrawn
+//=========================================================================================================
+void CSimIS31FL3731::draw()
+{
+    static const char* shade[] = { "  ", "..", "oo", "##" };
+
+    // The first time through, clear the screen (if we're the left-most board), draw the borders, and
+    // confine scrolling to the region below the matrix so that log output doesn't scroll the matrix away
+    if (!m_is_screen_ready)
+    {
+        if (m_first_col == 1) printf("\x1b[2J");
+        printf("\x1b[%d;%dH+%.*s+", FIRST_ROW_LINE - 1, m_first_col, COLS * 2, "--------------------------------");
+        for (int row = 0; row < ROWS; ++row) printf("\x1b[%d;%dH|%*s|", FIRST_ROW_LINE + row, m_first_col, COLS * 2, "");
+        printf("\x1b[%d;%dH+%.*s+", FIRST_ROW_LINE + ROWS, m_first_col, COLS * 2, "--------------------------------");
+        printf("\x1b[%dr\x1b[%d;1H", SCROLL_TOP_LINE, SCROLL_TOP_LINE);
+        memset(m_drawn, 0, sizeof m_drawn);
+        m_is_screen_ready = true;
+    }
+
+    // Save the cursor, redraw the cells that changed, and put the cursor back
+    printf("\x1b" "7");
+    for (int row = 0; row < ROWS; ++row) for (int col = 0; col < COLS; ++col)
+    {
+        if (m_image[row][col] == m_drawn[row][col]) continue;
+        m_drawn[row][col] = m_image[row][col];
+        int level = (m_image[row][col] + 84) / 85;
+        printf("\x1b[%d;%dH%s", FIRST_ROW_LINE + row, m_first_col + 1 + col * 2, shade[level]);
+    }
+    printf("\x1b" "8");
+    fflush(stdout);
+}
+//=========================================================================================================
@@ -0,0 +1,124 @@
+//=========================================================================================================
+// sim_is31fl3731.h - Defines a register-level model of the ISSI IS31FL3731 LED matrix driver
+//
+// The chip has eight frames (pages 0 thru 7) plus a page of function registers (page 0x0B).  Writing to
+// the command register (0xFD) selects which page the other registers refer to.  Each frame holds:
+//
+//     0x00 - 0x11 = LED control: one "on" bit per LED
+//     0x12 - 0x23 = Blink control
+//     0x24 - 0xB3 = PWM: one brightness byte per LED
+//
+// The image on the matrix is the frame selected by the picture-display register, with every LED whose
+// control bit is clear showing as dark.  While the shutdown register says "shutdown", the whole matrix
+// is dark.  In auto-play mode, the chip steps through frames on its own, in virtual time.  Breathing
+// (fading between frames) isn't modeled: frame changes are instantaneous.
+//
+// The board wired to the chip is LED_GEOMETRY (see common.h and led_geometry.h), the same one the
+// firmware is built for.
+//
+// refresh() is called once per pass through the firmware's loop().  If the visible image has changed,
+// that counts as a displayed frame, and the bus traffic it took to get there is recorded.  Optionally,
+// the image is drawn at the top of the terminal, redrawing only the cells that changed.
+//=========================================================================================================
+#ifndef _SIM_IS31FL3731_H_
+#define _SIM_IS31FL3731_H_
+#include <stdint.h>
+#include "sim_i2c.h"
+#include "common.h"
+#include "led_geometry.h"
+
+class CSimIS31FL3731 : public CSimI2CDevice
+{
+public:
+
+    // The chip's address with the AD pin tied to ground
+    enum { DEFAULT_ADDRESS = 0x74 };
+
+    // The size of the board
+    enum { ROWS = LED_GEOMETRY::ROWS, COLS = LED_GEOMETRY::COLS };
+
+    // Constructor: the chip is in its power-on state
+    CSimIS31FL3731();
+
+    // Checks for a newly displayed image.  Call this each time the firmware's loop() returns
+    void    refresh();
+
+    // Turns drawing to the terminal on or off.  "position" says how many boards are to our left
+    void    set_terminal(bool flag, int position = 0)
+    {
+        m_is_drawing = flag;
+        m_is_screen_ready = false;
+        m_first_col = 1 + position * (COLS * 2 + 2);
+    }
+
+    // Returns the brightness of the LED at a row and column of the visible image
+    uint8_t pixel(int row, int col);
+
+    // Traffic counters, for measuring what each displayed image costs
+    struct stats_t
+    {
+        uint32_t frames;                            // Images displayed
+        uint32_t bytes, transactions;               // Totals, over every frame
+        uint32_t last_bytes, last_transactions;     // What the most recent frame cost
+        uint32_t peak_bytes, peak_transactions;     // What the most expensive frame cost
+    };
+    const stats_t& get_stats() { return m_stats; }
+
+    // CSimI2CDevice
+    bool     on_start(bool is_read);
+    bool     on_write(uint8_t data);
+    uint8_t  on_read();
+
+protected:
+
+    // Pages and registers
+    enum { FRAME_COUNT = 8, FRAME_SIZE = 0xB4, FUNCTION_PAGE = 0x0B, FUNCTION_SIZE = 0x0D };
+    enum { COMMAND_REG = 0xFD, LED_CTRL_REG = 0x00, PWM_REG = 0x24 };
+    enum { CONFIG_REG = 0x00, PICTURE_REG = 0x01, AUTOPLAY1_REG = 0x02, AUTOPLAY2_REG = 0x03 };
+    enum { SHUTDOWN_REG = 0x0A };
+
+    // The auto-play clock, in microseconds per tick of the frame delay
+    enum { AUTOPLAY_TICK_US = 11000 };
+
+    // Returns a pointer to the selected register (or nullptr if it doesn't exist)
+    uint8_t* reg(uint8_t address);
+
+    // Returns the frame that auto-play is showing right now
+    int     autoplay_frame();
+
+    // Computes the image the matrix is showing right now
+    void    compute_image(uint8_t image[ROWS][COLS]);
+
+    // Draws the cells of the visible image that have changed since the last time it was drawn
+    void    draw();
+
+    // The register file
+    uint8_t  m_frame[FRAME_COUNT][FRAME_SIZE];
+    uint8_t  m_function[FUNCTION_SIZE];
+
+    // The selected page, the register pointer, and whether the next byte written is a register address
+    uint8_t  m_page;
+    uint8_t  m_pointer;
+    bool     m_is_address_next;
+
+    // When auto-play was last started
+    uint64_t m_autoplay_us;
+
+    // The image as of the most recent displayed frame, and as last drawn on the terminal
+    uint8_t  m_image[ROWS][COLS];
+    uint8_t  m_drawn[ROWS][COLS];
+
+    // Traffic since the most recent displayed frame
+    uint32_t m_pending_bytes, m_pending_transactions;
+
+    // Whether we draw on the terminal, and whether the terminal has been set up for it yet
+    bool     m_is_drawing;
+    bool     m_is_screen_ready;
+
+    // The terminal column where our left border is drawn
+    int      m_first_col;
+
+    stats_t  m_stats;
+};
+
+#endif
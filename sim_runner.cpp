@@ -0,0 +1,181 @@
+//=========================================================================================================
+// sim_runner.cpp - Implements the fleet runner
+//=========================================================================================================
+#include <stdio.h>
+#include <thread>
+#include "sim_runner.h"
+#include "sim_device.h"
+
+
+//=========================================================================================================
+// set_boot_trace() - Selects the trace that brings every device in the fleet to its starting state
+//=========================================================================================================
+void CSimRunner::set_boot_trace(const std::string& trace, const char* trace_name)
+{
+    m_boot_trace      = trace;
+    m_boot_trace_name = trace_name;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// build_device() - Builds a device and makes it the current device for this thread
+//=========================================================================================================
+CSimDevice* CSimRunner::build_device(const char* name)
+{
+    CSimDevice* device = new CSimDevice(name);
+    device->select();
+
+    // If there's a booted template, start from a copy of it.  Otherwise, configure the virtual clock
+    // and the EEPROM
+    if (m_template)
+        device->restore(*m_template);
+    else
+    {
+        device->clock.set_mode(m_clock.mode, m_clock.scale);
+        device->eeprom.configure(m_eeprom);
+    }
+
+    // Only a lone device keeps its EEPROM in a file.  Fleet devices start out blank (or as the template
+    // left them).  A copy never inherits its original's file, but for a lone device the file holds exactly
+    // what the template's EEPROM does, so it can pick the file right back up
+    if (m_device_count == 1) device->eeprom.load("eeprom.bin");
+    return device;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// boot() - Runs the boot trace on a template device and snapshots the result
+//
+// Returns: The exit status of the boot trace
+//=========================================================================================================
+int CSimRunner::boot()
+{
+    // Build a device from scratch and run the boot trace on it
+    CSimDevice* device = build_device("boot");
+    if (!device->stimulus.load(m_boot_trace.c_str(), m_boot_trace_name.c_str()))
+    {
+        delete device;
+        return CSimStimulus::EXIT_BAD_TRACE;
+    }
+    int status = device->run(m_clock.limit_us);
+
+    // Keep a snapshot of the booted device for the fleet to start from
+    if (status == 0) m_template = device->snapshot();
+
+    // We're done with the boot device itself
+    delete device;
+    sim_current_device = nullptr;
+    return status;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// run_device() - Builds a device, runs the trace against it, and returns its exit status
+//=========================================================================================================
+int CSimRunner::run_device(int index)
+{
+    char name[16] = "";
+
+    // When there's more than one device, each device's output is tagged with its name
+    if (m_device_count > 1) snprintf(name, sizeof name, "dev%d", index);
+
+    // Build the device in its starting state, and make it the current device for this thread
+    CSimDevice* device = build_device(name);
+
+    // Schedule the stimulus, and if it's malformed, this device is done
+    int status = CSimStimulus::EXIT_BAD_TRACE;
+    if (device->stimulus.load(m_trace.c_str(), m_trace_name.c_str())) status = device->run(m_clock.limit_us);
+
+    // We're done with this device
+    delete device;
+    sim_current_device = nullptr;
+    return status;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// worker() - Runs devices, one after another, until there are none left
+//=========================================================================================================
+void CSimRunner::worker()
+{
+    while (true)
+    {
+        int index = m_next_device++;
+        if (index >= m_device_count) return;
+        m_status[index] = run_device(index);
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// run() - Runs a fleet of devices on a pool of worker threads
+//
+// Passed:  device_count = How many devices to simulate
+//          thread_count = How many worker threads to use.  0 = one per CPU core
+//          clock        = How the virtual clock on each device runs
+//          trace        = The text of the stimulus trace that every device replays
+//          trace_name   = The name of the trace, for error messages
+//
+// Returns: The highest exit status of any device
+//=========================================================================================================
+int CSimRunner::run(int device_count, int thread_count, const clock_cfg_t& clock,
+                    const std::string& trace, const char* trace_name)
+{
+    // Save our configuration where the workers can find it
+    m_device_count = device_count;
+    m_clock        = clock;
+    m_trace        = trace;
+    m_trace_name   = trace_name;
+    m_next_device  = 0;
+    m_status.assign(device_count, 0);
+
+    // If there's a boot trace, bring the template device to its starting state
+    if (!m_boot_trace.empty())
+    {
+        int status = boot();
+        if (status)
+        {
+            fprintf(stderr, "Boot trace failed with status %d\n", status);
+            return status;
+        }
+    }
+
+    // Figure out how many worker threads to use
+    if (thread_count < 1) thread_count = std::thread::hardware_concurrency();
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > device_count) thread_count = device_count;
+
+    // A single worker just runs on this thread
+    if (thread_count == 1)
+        worker();
+
+    // Otherwise, start the pool and wait for it to finish
+    else
+    {
+        std::vector<std::thread> pool;
+        for (int i = 0; i < thread_count; ++i) pool.push_back(std::thread(&CSimRunner::worker, this));
+        for (auto& thread : pool) thread.join();
+    }
+
+    // Summarize the results and find the worst exit status
+    int worst = 0, failed = 0;
+    for (int status : m_status)
+    {
+        if (status) ++failed;
+        if (status > worst) worst = status;
+    }
+
+    if (device_count > 1) fprintf(stderr, "%d devices, %d passed, %d failed\n", device_count, device_count - failed, failed);
+
+    // We're done with the template
+    delete m_template;
+    m_template = nullptr;
+
+    return worst;
+}
+//=========================================================================================================
@@ -0,0 +1,76 @@
+//=========================================================================================================
+// sim_runner.h - Defines the fleet runner that shards many independent simulated devices across a
+//                pool of worker threads
+//
+// Every device gets its own CSimDevice, and every device replays the same stimulus trace.  A worker
+// runs one device from power-up until its trace ends, then picks up the next device that hasn't been
+// run yet.  Devices never share state, so the workers never need to synchronize with each other.
+//
+// Optionally, a "boot" trace is run once on a template device first, and then every device in the
+// fleet starts from a snapshot of that template instead of from power-up.
+//=========================================================================================================
+#ifndef _SIM_RUNNER_H_
+#define _SIM_RUNNER_H_
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "sim_clock.h"
+#include "sim_eeprom.h"
+
+class CSimDevice;
+
+class CSimRunner
+{
+public:
+
+    // Describes how each device's virtual clock should run
+    struct clock_cfg_t { CSimClock::mode_t mode; double scale; uint64_t limit_us; };
+
+    // Constructor
+    CSimRunner() { m_template = nullptr; m_eeprom = CSimEEPROM::DEFAULT_CONFIG; }
+
+    // Sets the size and flush policy of every device's EEPROM
+    void    set_eeprom_config(const CSimEEPROM::config_t& config) { m_eeprom = config; }
+
+    // Selects a trace to be run once, before any of the fleet, to bring the devices to a known state
+    void    set_boot_trace(const std::string& trace, const char* trace_name);
+
+    // Runs "device_count" devices on "thread_count" worker threads.  Returns the worst exit status
+    int     run(int device_count, int thread_count, const clock_cfg_t& clock,
+                const std::string& trace, const char* trace_name);
+
+protected:
+
+    // Each worker thread runs this until there are no devices left to run
+    void    worker();
+
+    // Runs the boot trace on a template device and keeps a snapshot of the result
+    int     boot();
+
+    // Builds a device in its starting state: either powered-off or a copy of the booted template
+    CSimDevice* build_device(const char* name);
+
+    // Runs a single device from power-up to the end of the trace
+    int     run_device(int index);
+
+    // What we were asked to run
+    int                 m_device_count;
+    clock_cfg_t         m_clock;
+    CSimEEPROM::config_t m_eeprom;
+    std::string         m_trace;
+    std::string         m_trace_name;
+    std::string         m_boot_trace;
+    std::string         m_boot_trace_name;
+
+    // If there's a boot trace, this is the device that every device in the fleet starts out as
+    CSimDevice*         m_template;
+
+    // The index of the next device to be run
+    std::atomic<int>    m_next_device;
+
+    // The exit status of each device
+    std::vector<int>    m_status;
+};
+
+#endif
@@ -0,0 +1,218 @@
+//=========================================================================================================
+// sim_sched.cpp - Implements the discrete-event scheduler for simulated pin edges and ISR firings
+//=========================================================================================================
+#include <Arduino.h>
+#include "sim_device.h"
+
+
+//=========================================================================================================
+// pin_event() - Builds an event that drives a pin to a given state
+//=========================================================================================================
+CSimScheduler::event_t CSimScheduler::pin_event(uint64_t when_us, int pin, int state)
+{
+    return { when_us, 0, PIN_EDGE, pin, state, 0, nullptr, "" };
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// isr_event() - Builds an event that raises an interrupt vector
+//=========================================================================================================
+CSimScheduler::event_t CSimScheduler::isr_event(uint64_t when_us, int vector)
+{
+    return { when_us, 0, ISR, 0, 0, vector, nullptr, "" };
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// call_event() - Builds an event that calls an arbitrary function (with a line of text) on the
+//                simulation thread
+//=========================================================================================================
+CSimScheduler::event_t CSimScheduler::call_event(uint64_t when_us, void (*fn)(const char*), const char* text)
+{
+    return { when_us, 0, CALL, 0, 0, 0, fn, text };
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// operator=() - Copies the pending events of another scheduler
+//=========================================================================================================
+CSimScheduler& CSimScheduler::operator=(const CSimScheduler& rhs)
+{
+    if (this == &rhs) return *this;
+
+    // Hold both inbox locks so that neither inbox changes underneath us
+    std::lock(m_inbox_mutex, rhs.m_inbox_mutex);
+    std::lock_guard<std::mutex> lock1(m_inbox_mutex, std::adopt_lock);
+    std::lock_guard<std::mutex> lock2(rhs.m_inbox_mutex, std::adopt_lock);
+
+    m_queue = rhs.m_queue;
+    m_seq   = rhs.m_seq;
+    m_inbox = rhs.m_inbox;
+    return *this;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// enqueue() - Adds an event to the queue and registers its timestamp with the virtual clock
+//=========================================================================================================
+void CSimScheduler::enqueue(event_t event)
+{
+    // Stamp the event so that simultaneous events fire in the order they were scheduled
+    event.seq = m_seq++;
+
+    // Add the event to our queue
+    m_queue.push(event);
+
+    // Make sure the virtual clock doesn't idle past this event
+    SimClock.add_deadline(event.when);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// schedule_pin() - Schedules a pin to be driven to a given state at a given virtual time
+//=========================================================================================================
+void CSimScheduler::schedule_pin(uint64_t when_us, int pin, int state)
+{
+    event_t event = pin_event(0, pin, state);
+    event.when = when_us;
+    enqueue(event);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// schedule_isr() - Schedules an interrupt vector to be raised at a given virtual time
+//=========================================================================================================
+void CSimScheduler::schedule_isr(uint64_t when_us, int vector)
+{
+    event_t event = isr_event(0, vector);
+    event.when = when_us;
+    enqueue(event);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// post() - Thread-safe.  Queues a batch of events with timestamps relative to the moment the simulation
+//          thread picks them up
+//=========================================================================================================
+void CSimScheduler::post(const std::vector<event_t>& batch)
+{
+    std::lock_guard<std::mutex> lock(m_inbox_mutex);
+    m_inbox.push_back(batch);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// merge_inbox() - Moves batches that were posted from other threads into the event queue
+//=========================================================================================================
+void CSimScheduler::merge_inbox()
+{
+    std::vector<std::vector<event_t>> inbox;
+
+    // Grab the inbox while holding the lock for as short a time as possible
+    {
+        std::lock_guard<std::mutex> lock(m_inbox_mutex);
+        if (m_inbox.empty()) return;
+        inbox.swap(m_inbox);
+    }
+
+    // Every event in a batch is relative to this moment
+    uint64_t now = SimClock.micros();
+
+    // Convert the relative timestamps to absolute ones and queue up the events
+    for (auto& batch : inbox) for (auto event : batch)
+    {
+        event.when += now;
+        enqueue(event);
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// dispatch() - Performs the action described by an event
+//=========================================================================================================
+void CSimScheduler::dispatch(const event_t& event)
+{
+    switch (event.type)
+    {
+        case PIN_EDGE:
+            sim_input(event.pin, event.state);
+            break;
+
+        case ISR:
+            SimIrq.raise(event.vector);
+            break;
+
+        case CALL:
+            event.fn(event.text.c_str());
+            break;
+    }
+
+    // Deliver any interrupt this event caused
+    SimIrq.service();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// run_due() - Processes every event whose timestamp has arrived, in timestamp order
+//
+// Returns: The number of events that were processed
+//=========================================================================================================
+int CSimScheduler::run_due()
+{
+    int count = 0;
+
+    // Pick up anything that other threads have posted
+    merge_inbox();
+
+    // What time is it now?
+    uint64_t now = SimClock.micros();
+
+    // Process every event that's due
+    while (!m_queue.empty() && m_queue.top().when <= now)
+    {
+        // Remove the event from the queue before dispatching it, in case the handler schedules more
+        event_t event = m_queue.top();
+        m_queue.pop();
+
+        // And perform the action
+        dispatch(event);
+        ++count;
+    }
+
+    // Tell the caller how many events we processed
+    return count;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// next_event() - Fetches the timestamp of the earliest pending event
+//=========================================================================================================
+bool CSimScheduler::next_event(uint64_t* p_when_us)
+{
+    if (m_queue.empty()) return false;
+    *p_when_us = m_queue.top().when;
+    return true;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// is_empty() - Returns true if there are no events waiting to be processed
+//=========================================================================================================
+bool CSimScheduler::is_empty()
+{
+    std::lock_guard<std::mutex> lock(m_inbox_mutex);
+    return m_queue.empty() && m_inbox.empty();
+}
+//=========================================================================================================
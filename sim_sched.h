@@ -0,0 +1,104 @@
+//=========================================================================================================
+// sim_sched.h - Defines the discrete-event scheduler that drives simulated pin edges and ISR firings
+//
+// Events are time-stamped in virtual time (see sim_clock.h) and are processed strictly in order of their
+// timestamp.  Events with identical timestamps are processed in the order they were scheduled.
+//
+// After each event is processed, any interrupt it raised is delivered via the interrupt controller.
+//
+// Events can be scheduled two ways:
+//
+//     schedule_xxx() = From the simulation thread, at an absolute virtual time
+//     post()         = From any thread, relative to the moment the simulation thread picks it up
+//=========================================================================================================
+#ifndef _SIM_SCHED_H_
+#define _SIM_SCHED_H_
+#include <stdint.h>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <string>
+
+class CSimScheduler
+{
+public:
+
+    // These are the kinds of events we know how to process
+    enum type_t : char { PIN_EDGE, ISR, CALL };
+
+    // A single scheduled event
+    struct event_t
+    {
+        uint64_t    when;       // Virtual time (in microseconds) when this event fires
+        uint32_t    seq;        // Tie-breaker so that simultaneous events fire in the order scheduled
+        type_t      type;       // What kind of event this is
+        int         pin;        // PIN_EDGE: The pin being driven
+        int         state;      // PIN_EDGE: The state the pin is driven to
+        int         vector;     // ISR: The interrupt vector to raise
+        void        (*fn)(const char* text);    // CALL: The function to call
+        std::string text;       // CALL: The text handed to the function
+    };
+
+    // Constructor
+    CSimScheduler() { m_seq = 0; }
+
+    // Copying a scheduler copies every pending event, including any that are still in the inbox
+    CSimScheduler(const CSimScheduler& rhs) { *this = rhs; }
+    CSimScheduler& operator=(const CSimScheduler& rhs);
+
+    // Schedules an event at an absolute virtual time.  Call these only from the simulation thread
+    void    schedule(const event_t& event) { enqueue(event); }
+    void    schedule_pin(uint64_t when_us, int pin, int state);
+    void    schedule_isr(uint64_t when_us, int vector);
+
+    // Thread-safe: queues a batch of events whose "when" fields are relative to the moment the
+    // simulation thread picks them up.  The whole batch shares the same starting point in time
+    void    post(const std::vector<event_t>& batch);
+
+    // Processes every event that is due as of the current virtual time.  Returns the number processed
+    int     run_due();
+
+    // Fetches the timestamp of the next pending event.  Returns false if there isn't one
+    bool    next_event(uint64_t* p_when_us);
+
+    // Returns true if there are no events waiting to be processed
+    bool    is_empty();
+
+    // Convenience routines for building events.  "when" is absolute for schedule(), relative for post()
+    static event_t pin_event(uint64_t when_us, int pin, int state);
+    static event_t isr_event(uint64_t when_us, int vector);
+    static event_t call_event(uint64_t when_us, void (*fn)(const char*), const char* text = "");
+
+protected:
+
+    // Adds an event to the queue and tells the virtual clock when it's due
+    void    enqueue(event_t event);
+
+    // Moves events that were posted from other threads into the queue
+    void    merge_inbox();
+
+    // Performs the action described by an event
+    void    dispatch(const event_t& event);
+
+    // Orders the priority queue so that the earliest event is on top
+    struct later_t
+    {
+        bool operator()(const event_t& a, const event_t& b) const
+        {
+            if (a.when != b.when) return a.when > b.when;
+            return a.seq > b.seq;
+        }
+    };
+
+    // The queue of pending events, earliest first
+    std::priority_queue<event_t, std::vector<event_t>, later_t> m_queue;
+
+    // The next sequence number to hand out
+    uint32_t    m_seq;
+
+    // Batches of events posted from other threads, and the mutex that protects them
+    std::vector<std::vector<event_t>> m_inbox;
+    mutable std::mutex m_inbox_mutex;
+};
+
+#endif
@@ -0,0 +1,400 @@
+//=========================================================================================================
+// sim_serial.cpp - Implements the simulated UART that sits behind "Serial"
+//=========================================================================================================
+#include <string.h>
+#include "sim_device.h"
+
+#ifdef __linux__
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#endif
+
+
+//=========================================================================================================
+// sim_serial() - The Serial macro uses this to find the current device's serial port
+//=========================================================================================================
+CArduinoSerial& sim_serial() { return sim_device().serial; }
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Constructor() - The port starts out with empty buffers and no pseudo-terminal
+//=========================================================================================================
+CArduinoSerial::CArduinoSerial()
+{
+    m_rx_head = m_rx_tail = m_tx_head = m_tx_tail = 0;
+    m_tx_shift = 0;
+    m_is_tx_busy = m_is_rx_busy = false;
+    m_tx_done_us = 0;
+    m_line_length = 0;
+    m_baud = 0;
+    m_frame_us = 0;
+    m_pty_master = m_pty_slave = -1;
+    memset(&m_stats, 0, sizeof m_stats);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Destructor() - Closes the pseudo-terminal if we have one
+//=========================================================================================================
+CArduinoSerial::~CArduinoSerial()
+{
+#ifdef __linux__
+    if (m_pty_slave  >= 0) close(m_pty_slave);
+    if (m_pty_master >= 0) close(m_pty_master);
+#endif
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Copy constructor and operator=() - Copy everything except the pseudo-terminal, which stays with the
+//                                    port that opened it
+//=========================================================================================================
+CArduinoSerial::CArduinoSerial(const CArduinoSerial& rhs) : CArduinoSerial()
+{
+    *this = rhs;
+}
+
+CArduinoSerial& CArduinoSerial::operator=(const CArduinoSerial& rhs)
+{
+    memcpy(m_rx, rhs.m_rx, sizeof m_rx);
+    memcpy(m_tx, rhs.m_tx, sizeof m_tx);
+    memcpy(m_line, rhs.m_line, sizeof m_line);
+    m_rx_head     = rhs.m_rx_head;
+    m_rx_tail     = rhs.m_rx_tail;
+    m_tx_head     = rhs.m_tx_head;
+    m_tx_tail     = rhs.m_tx_tail;
+    m_rx_wire     = rhs.m_rx_wire;
+    m_tx_shift    = rhs.m_tx_shift;
+    m_is_tx_busy  = rhs.m_is_tx_busy;
+    m_is_rx_busy  = rhs.m_is_rx_busy;
+    m_tx_done_us  = rhs.m_tx_done_us;
+    m_line_length = rhs.m_line_length;
+    m_baud        = rhs.m_baud;
+    m_frame_us    = rhs.m_frame_us;
+    m_stats       = rhs.m_stats;
+    return *this;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// begin() - Opens the port at the given baud rate and frame format
+//=========================================================================================================
+void CArduinoSerial::begin(unsigned long baud, uint8_t config)
+{
+    // Decode the frame format the same way the UART does: UCSZ gives the number of data bits, UPM
+    // turns on the parity bit, and USBS selects two stop bits
+    int data_bits   = 5 + ((config >> 1) & 3);
+    int parity_bits = (config & 0x30) ? 1 : 0;
+    int stop_bits   = (config & 0x08) ? 2 : 1;
+    int frame_bits  = 1 + data_bits + parity_bits + stop_bits;
+
+    // How long does one frame take, to the nearest microsecond?
+    m_baud = baud;
+    m_frame_us = (baud == 0) ? 0 : (uint32_t)((frame_bits * 1000000ULL + baud / 2) / baud);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// available() - Returns the number of received bytes waiting to be read
+//=========================================================================================================
+int CArduinoSerial::available()
+{
+    return (RX_BUFFER_SIZE + m_rx_head - m_rx_tail) % RX_BUFFER_SIZE;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// availableForWrite() - Returns the number of bytes that can be written without blocking
+//=========================================================================================================
+int CArduinoSerial::availableForWrite()
+{
+    return TX_BUFFER_SIZE - 1 - (TX_BUFFER_SIZE + m_tx_head - m_tx_tail) % TX_BUFFER_SIZE;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// peek() - Returns the next received byte without removing it, or -1 if there isn't one
+//=========================================================================================================
+int CArduinoSerial::peek()
+{
+    if (m_rx_head == m_rx_tail) return -1;
+    return m_rx[m_rx_tail];
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// read() - Returns the next received byte, or -1 if there isn't one
+//=========================================================================================================
+int CArduinoSerial::read()
+{
+    if (m_rx_head == m_rx_tail) return -1;
+    uint8_t c = m_rx[m_rx_tail];
+    m_rx_tail = (m_rx_tail + 1) % RX_BUFFER_SIZE;
+    return c;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// write() - Places a byte in the TX ring and starts it on its way
+//=========================================================================================================
+size_t CArduinoSerial::write(uint8_t c)
+{
+    // If the port hasn't been opened, there's no baud rate to honor.  The byte goes out immediately
+    if (m_frame_us == 0)
+    {
+        emit(c);
+        return 1;
+    }
+
+    uint16_t next = (m_tx_head + 1) % TX_BUFFER_SIZE;
+
+    // Just like the AVR core, if the TX ring is full we wait for the UART to make room
+    if (next == m_tx_tail)
+    {
+        uint64_t start_us = SimClock.micros();
+        while (next == m_tx_tail && sim_wait(m_tx_done_us));
+        m_stats.tx_stall_us += SimClock.micros() - start_us;
+
+        // If the simulation ended while we were waiting, this byte never gets sent
+        if (next == m_tx_tail)
+        {
+            ++m_stats.tx_dropped;
+            return 0;
+        }
+    }
+
+    m_tx[m_tx_head] = c;
+    m_tx_head = next;
+
+    // If the UART is idle, get it started
+    if (!m_is_tx_busy) start_tx();
+    return 1;
+}
+
+size_t CArduinoSerial::write(const void* buffer, size_t length)
+{
+    const uint8_t* in = (const uint8_t*)buffer;
+    for (size_t i = 0; i < length; ++i) write(in[i]);
+    return length;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// print() and println() - Write a string, and optionally a line terminator
+//=========================================================================================================
+size_t CArduinoSerial::print(const char* text)
+{
+    return write(text, strlen(text));
+}
+
+size_t CArduinoSerial::println(const char* text)
+{
+    return print(text) + print("\r\n");
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// flush() - Waits for all transmitted data to leave the UART
+//=========================================================================================================
+void CArduinoSerial::flush()
+{
+    while (m_is_tx_busy && sim_wait(m_tx_done_us));
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// inject() - Puts bytes on the RX wire.  They arrive one frame time apart
+//=========================================================================================================
+void CArduinoSerial::inject(const void* data, size_t length)
+{
+    const uint8_t* in = (const uint8_t*)data;
+
+    // If the port hasn't been opened, the receiver is off and the bytes are lost
+    if (m_frame_us == 0)
+    {
+        m_stats.rx_dropped += length;
+        return;
+    }
+
+    m_rx_wire.insert(m_rx_wire.end(), in, in + length);
+
+    // If the receiver is idle, the first byte starts arriving now
+    if (!m_is_rx_busy) start_rx();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// start_rx() - Starts the next byte on the RX wire arriving
+//=========================================================================================================
+void CArduinoSerial::start_rx()
+{
+    m_is_rx_busy = true;
+    SimScheduler.schedule(CSimScheduler::call_event(SimClock.micros() + m_frame_us, on_rx_done));
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_rx_done() - Scheduled action: a byte has finished arriving.  Just like the real UART, if there's no
+//                room for it, it's lost
+//=========================================================================================================
+void CArduinoSerial::on_rx_done(const char*)
+{
+    CArduinoSerial& port = Serial;
+
+    port.m_is_rx_busy = false;
+    if (port.m_rx_wire.empty()) return;
+
+    uint8_t c = port.m_rx_wire.front();
+    port.m_rx_wire.pop_front();
+
+    uint16_t next = (port.m_rx_head + 1) % RX_BUFFER_SIZE;
+    if (next == port.m_rx_tail)
+        ++port.m_stats.rx_dropped;
+    else
+    {
+        port.m_rx[port.m_rx_head] = c;
+        port.m_rx_head = next;
+        ++port.m_stats.rx_bytes;
+    }
+
+    // And the next byte starts arriving
+    if (!port.m_rx_wire.empty()) port.start_rx();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// start_tx() - Moves the next byte from the TX ring into the shift register
+//=========================================================================================================
+void CArduinoSerial::start_tx()
+{
+    m_tx_shift = m_tx[m_tx_tail];
+    m_tx_tail = (m_tx_tail + 1) % TX_BUFFER_SIZE;
+
+    m_is_tx_busy = true;
+    m_tx_done_us = SimClock.micros() + m_frame_us;
+    SimScheduler.schedule(CSimScheduler::call_event(m_tx_done_us, on_tx_done));
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_tx_done() - Scheduled action: a byte has finished shifting out
+//=========================================================================================================
+void CArduinoSerial::on_tx_done(const char*)
+{
+    CArduinoSerial& port = Serial;
+
+    port.m_is_tx_busy = false;
+    port.emit(port.m_tx_shift);
+
+    // If there's more waiting in the TX ring, start on the next byte
+    if (port.m_tx_tail != port.m_tx_head) port.start_tx();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// emit() - Hands a transmitted byte to the pseudo-terminal, or to the simulator log
+//=========================================================================================================
+void CArduinoSerial::emit(uint8_t c)
+{
+    ++m_stats.tx_bytes;
+
+#ifdef __linux__
+    // If there's a pseudo-terminal, the byte goes there.  If nobody is reading the other end and
+    // the terminal is full, the byte is lost, just as it would be on a real wire
+    if (m_pty_master >= 0)
+    {
+        if (::write(m_pty_master, &c, 1) != 1) ++m_stats.tx_dropped;
+        return;
+    }
+#endif
+
+    // Otherwise, collect a line of text and log it when it's complete
+    if (c == '\r') return;
+    if (c == '\n' || m_line_length == sizeof(m_line) - 1)
+    {
+        m_line[m_line_length] = 0;
+        sim_log("%s\n", m_line);
+        m_line_length = 0;
+        if (c == '\n') return;
+    }
+    m_line[m_line_length++] = c;
+}
+//=========================================================================================================
+
+
+#ifdef __linux__
+//=========================================================================================================
+// open_pty() - Creates a pseudo-terminal for this port
+//
+// Returns: The name of the slave device that host tools should open, or nullptr on failure
+//=========================================================================================================
+const char* CArduinoSerial::open_pty()
+{
+    // Create the master side of the pseudo-terminal
+    m_pty_master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (m_pty_master < 0) return nullptr;
+
+    // Make the slave side available for opening
+    if (grantpt(m_pty_master) != 0 || unlockpt(m_pty_master) != 0) return nullptr;
+    const char* name = ptsname(m_pty_master);
+    if (name == nullptr) return nullptr;
+
+    // We hold the slave open ourselves so that the master never sees a hang-up when a host tool
+    // disconnects.  This also lets us put the line into raw mode: no echo, no line editing
+    m_pty_slave = open(name, O_RDWR | O_NOCTTY);
+    if (m_pty_slave >= 0)
+    {
+        termios raw;
+        tcgetattr(m_pty_slave, &raw);
+        cfmakeraw(&raw);
+        tcsetattr(m_pty_slave, TCSANOW, &raw);
+    }
+
+    // Let the host loop tell us when the host tool sends us something
+    SimHost.add_fd(m_pty_master, [](int, void* context) { ((CArduinoSerial*)context)->poll_pty(); }, this);
+
+    return name;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// poll_pty() - Puts everything the host tool has sent onto the RX wire.  Just like a real serial line,
+//              there's no flow control: if the firmware doesn't keep up, bytes are lost
+//=========================================================================================================
+void CArduinoSerial::poll_pty()
+{
+    uint8_t buffer[256];
+    ssize_t count;
+
+    if (m_pty_master < 0) return;
+
+    while ((count = ::read(m_pty_master, buffer, sizeof buffer)) > 0) inject(buffer, count);
+}
+//=========================================================================================================
+
+#else
+
+const char* CArduinoSerial::open_pty() { return nullptr; }
+void CArduinoSerial::poll_pty() {}
+
+#endif
@@ -0,0 +1,260 @@
+//=========================================================================================================
+// sim_sht31.cpp - Implements a model of the Sensirion SHT31 temperature/humidity sensor
+//=========================================================================================================
+#include <string.h>
+#include <math.h>
+#include "sim_device.h"
+#include "sim_sht31.h"
+
+// The commands we understand
+#define CMD_HIGH_STRETCH    0x2C06
+#define CMD_MED_STRETCH     0x2C0D
+#define CMD_LOW_STRETCH     0x2C10
+#define CMD_HIGH            0x2400
+#define CMD_MED             0x240B
+#define CMD_LOW             0x2416
+#define CMD_SOFT_RESET      0x30A2
+
+// Worst-case measurement times from the datasheet, in microseconds
+#define HIGH_REP_US         15500
+#define MED_REP_US           6500
+#define LOW_REP_US           4500
+
+
+//=========================================================================================================
+// crc8() - The datasheet's CRC: polynomial 0x31, initial value 0xFF.  This is computed bit by bit on
+//          purpose, so that it checks the driver's table-driven version rather than sharing its table
+//=========================================================================================================
+static uint8_t crc8(const uint8_t* in, int count)
+{
+    uint8_t crc = 0xFF;
+
+    while (count--)
+    {
+        crc ^= *in++;
+        for (int bit = 0; bit < 8; ++bit) crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+    }
+
+    return crc;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Constructor() - A freshly powered sensor, idle, in a comfortable room
+//=========================================================================================================
+CSimSHT31::CSimSHT31()
+{
+    m_command = 0;
+    m_command_length = 0;
+    m_is_measuring = m_is_stretching = m_has_result = false;
+    m_ready_us = 0;
+    m_result_index = 0;
+    memset(m_result, 0, sizeof m_result);
+    m_corrupt_count = 0;
+    memset(&m_stats, 0, sizeof m_stats);
+    set_environment(25, 50);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// set_environment() - Programs the temperature and humidity the sensor sees
+//=========================================================================================================
+void CSimSHT31::set_environment(float temp_c, float rh, float temp_swing, float rh_swing, uint32_t period_ms)
+{
+    m_temp_c     = temp_c;
+    m_rh         = rh;
+    m_temp_swing = temp_swing;
+    m_rh_swing   = rh_swing;
+    m_period_ms  = period_ms;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// sample() - Returns the value of a waveform at a given moment in virtual time
+//=========================================================================================================
+float CSimSHT31::sample(float base, float swing, uint64_t when_us)
+{
+    if (m_period_ms == 0) return base;
+    double phase = (double)(when_us % (m_period_ms * 1000ULL)) / (m_period_ms * 1000.0);
+    return base + swing * (float)sin(2 * M_PI * phase);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// build_result() - Builds the temperature and humidity words (each with its CRC) that the master reads
+//=========================================================================================================
+void CSimSHT31::build_result(uint64_t when_us)
+{
+    float temp_c = sample(m_temp_c, m_temp_swing, when_us);
+    float rh     = sample(m_rh,     m_rh_swing,   when_us);
+
+    // The sensor's output range
+    if (temp_c < -45) temp_c = -45;
+    if (temp_c > 130) temp_c = 130;
+    if (rh < 0)       rh = 0;
+    if (rh > 100)     rh = 100;
+
+    // Convert to raw readings, the inverse of the datasheet's conversion formulas
+    uint16_t raw_temp = (uint16_t)lround((temp_c + 45) * 65535 / 175);
+    uint16_t raw_rh   = (uint16_t)lround(rh * 65535 / 100);
+
+    m_result[0] = raw_temp >> 8;
+    m_result[1] = raw_temp & 0xFF;
+    m_result[2] = crc8(m_result + 0, 2);
+    m_result[3] = raw_rh >> 8;
+    m_result[4] = raw_rh & 0xFF;
+    m_result[5] = crc8(m_result + 3, 2);
+
+    m_has_result = true;
+    m_result_index = 0;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// execute() - Carries out a command
+//
+// Returns: false if we don't recognize the command (the sensor NACKs it)
+//=========================================================================================================
+bool CSimSHT31::execute(uint16_t command)
+{
+    uint32_t duration_us;
+
+    switch (command)
+    {
+        case CMD_HIGH_STRETCH:  duration_us = HIGH_REP_US; m_is_stretching = true;  break;
+        case CMD_MED_STRETCH:   duration_us = MED_REP_US;  m_is_stretching = true;  break;
+        case CMD_LOW_STRETCH:   duration_us = LOW_REP_US;  m_is_stretching = true;  break;
+        case CMD_HIGH:          duration_us = HIGH_REP_US; m_is_stretching = false; break;
+        case CMD_MED:           duration_us = MED_REP_US;  m_is_stretching = false; break;
+        case CMD_LOW:           duration_us = LOW_REP_US;  m_is_stretching = false; break;
+
+        case CMD_SOFT_RESET:
+            m_is_measuring = m_has_result = false;
+            return true;
+
+        default:
+            return false;
+    }
+
+    // Start the measurement.  Any result that wasn't read out is lost
+    m_is_measuring = true;
+    m_has_result = false;
+    m_ready_us = SimClock.micros() + duration_us;
+    ++m_stats.measurements;
+    return true;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_start() - A transaction addressed to us is starting
+//=========================================================================================================
+bool CSimSHT31::on_start(bool is_read)
+{
+    // If a measurement has finished since we last looked, its result is ready to be read
+    if (m_is_measuring && SimClock.micros() >= m_ready_us)
+    {
+        m_is_measuring = false;
+        build_result(m_ready_us);
+    }
+
+    // While it's measuring, the sensor ignores commands
+    if (!is_read)
+    {
+        m_command_length = 0;
+        if (m_is_measuring) ++m_stats.busy_nacks;
+        return !m_is_measuring;
+    }
+
+    // A read during a clock-stretching measurement waits for it.  Otherwise, a read while measuring
+    // (or with nothing to read) gets NACKed
+    if (m_is_measuring && m_is_stretching) return true;
+    if (!m_has_result) ++m_stats.busy_nacks;
+    return m_has_result;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_stretch() - If the read arrived before the measurement is done, we hold the clock until it is
+//=========================================================================================================
+uint32_t CSimSHT31::on_stretch()
+{
+    if (!m_is_measuring) return 0;
+
+    uint64_t now = SimClock.micros();
+    uint32_t stretch_us = (m_ready_us > now) ? (uint32_t)(m_ready_us - now) : 0;
+
+    m_is_measuring = false;
+    build_result(m_ready_us);
+    m_stats.stretched_us += stretch_us;
+    return stretch_us;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_write() - Collects the two bytes of a command, then carries it out
+//=========================================================================================================
+bool CSimSHT31::on_write(uint8_t data)
+{
+    if (m_command_length == 0)
+    {
+        m_command = data << 8;
+        m_command_length = 1;
+        return true;
+    }
+
+    if (m_command_length == 1)
+    {
+        m_command |= data;
+        m_command_length = 2;
+        return execute(m_command);
+    }
+
+    // Commands are only two bytes long
+    return false;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_read() - Sends the next byte of the result.  Past the end of the result, the bus floats high
+//=========================================================================================================
+uint8_t CSimSHT31::on_read()
+{
+    if (m_result_index >= (int)sizeof(m_result)) return 0xFF;
+
+    int index = m_result_index++;
+    uint8_t data = m_result[index];
+
+    // If we've been asked to, send a bad CRC
+    if ((index == 2 || index == 5) && m_corrupt_count > 0)
+    {
+        data ^= 0x01;
+        --m_corrupt_count;
+        ++m_stats.corrupted;
+    }
+
+    return data;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// on_stop() - Once the result has been read, it's gone
+//=========================================================================================================
+void CSimSHT31::on_stop()
+{
+    if (m_has_result && m_result_index > 0)
+    {
+        m_has_result = false;
+        ++m_stats.reads;
+    }
+}
+//=========================================================================================================
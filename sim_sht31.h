@@ -0,0 +1,86 @@
+//=========================================================================================================
+// sim_sht31.h - Defines a model of the Sensirion SHT31 temperature/humidity sensor
+//
+// The model understands the single-shot measurement commands, with and without clock stretching, at
+// all three repeatabilities, plus soft-reset.  A measurement takes the datasheet's worst-case time:
+//
+//     Low repeatability    =  4.5 ms
+//     Medium repeatability =  6.5 ms
+//     High repeatability   = 15.5 ms
+//
+// A read that arrives before the measurement is done is either clock-stretched until it's done, or
+// NACKed, depending on which flavor of command started the measurement.
+//
+// The environment the sensor sees is programmable: a base temperature and humidity, each with an
+// optional sine-wave swing.  CRC corruption can be injected to exercise the driver's retry logic.
+//=========================================================================================================
+#ifndef _SIM_SHT31_H_
+#define _SIM_SHT31_H_
+#include <stdint.h>
+#include "sim_i2c.h"
+
+class CSimSHT31 : public CSimI2CDevice
+{
+public:
+
+    // The sensor's default I2C address (ADDR pin low)
+    enum { DEFAULT_ADDRESS = 0x44 };
+
+    // Constructor: 25 C and 50% relative humidity, holding steady
+    CSimSHT31();
+
+    // Programs the environment.  Temperature and humidity each swing sinusoidally by +/- "swing"
+    // around their base value, once per "period_ms".  A period of 0 means they hold steady
+    void    set_environment(float temp_c, float rh, float temp_swing = 0, float rh_swing = 0,
+                            uint32_t period_ms = 0);
+
+    // Corrupts the CRC of the next "count" CRC bytes the sensor sends
+    void    corrupt_crc(int count) { m_corrupt_count = count; }
+
+    // Counters, for measuring what the driver costs
+    struct stats_t { uint32_t measurements, reads, busy_nacks, stretched_us, corrupted; };
+    const stats_t& get_stats() { return m_stats; }
+
+    // CSimI2CDevice
+    bool     on_start(bool is_read);
+    uint32_t on_stretch();
+    bool     on_write(uint8_t data);
+    uint8_t  on_read();
+    void     on_stop();
+
+protected:
+
+    // Starts a measurement in response to a command.  Returns false if the command isn't one we know
+    bool    execute(uint16_t command);
+
+    // Builds the 6-byte result of the measurement that finished at "when_us"
+    void    build_result(uint64_t when_us);
+
+    // Returns the value of one of the environment's waveforms at a given moment
+    float   sample(float base, float swing, uint64_t when_us);
+
+    // The command being received, and how many of its bytes have arrived
+    uint16_t m_command;
+    int      m_command_length;
+
+    // The measurement in progress: when it will be done, and whether a read should clock-stretch
+    bool     m_is_measuring;
+    bool     m_is_stretching;
+    uint64_t m_ready_us;
+
+    // The result being read out, and the index of the next byte to send
+    uint8_t  m_result[6];
+    int      m_result_index;
+    bool     m_has_result;
+
+    // The environment
+    float    m_temp_c, m_rh, m_temp_swing, m_rh_swing;
+    uint32_t m_period_ms;
+
+    // How many more CRC bytes to corrupt
+    int      m_corrupt_count;
+
+    stats_t  m_stats;
+};
+
+#endif
@@ -0,0 +1,501 @@
+//=========================================================================================================
+// sim_stimulus.cpp - Implements the scripted stimulus player
+//=========================================================================================================
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <Arduino.h>
+#include "sim_device.h"
+#include "common.h"
+
+// How far apart (in microseconds) consecutive detents of a multi-detent "turn" are.  This has to be
+// longer than the knob's debounce time or the detents would merge into one
+#define DETENT_SPACING_US 100000
+
+// How long (in microseconds) the button stays down during a "click"
+#define CLICK_HOLD_US     200000
+
+// If a trace doesn't say when to end, we end this long (in microseconds) after the last stimulus
+#define DEFAULT_TAIL_US   3000000
+
+
+//=========================================================================================================
+// sim_log() - Prints a line of simulator output and records it for "expect"
+//=========================================================================================================
+void sim_log(const char* fmt, ...)
+{
+    char buffer[256];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof buffer, fmt, args);
+    va_end(args);
+
+    // When several devices are running, say which one this came from
+    const char* name = sim_device().name.c_str();
+    if (*name)
+        printf("%s: %s", name, buffer);
+    else
+        fputs(buffer, stdout);
+
+    SimStimulus.record(buffer);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Constructor
+//=========================================================================================================
+CSimStimulus::CSimStimulus()
+{
+    m_failures = 0;
+    m_pending_expects = 0;
+    m_finished = false;
+    m_end_status = 0;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// record() - Appends a chunk of output to the transcript that "expect" searches.  Once no "expect" is
+//            left to run, there's nothing to keep it for
+//=========================================================================================================
+void CSimStimulus::record(const char* text)
+{
+    if (m_pending_expects) m_transcript += text;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// add_button() - Adds the events for a change in the click-button state to a batch.  The contact
+//                bounces once before settling.  The pin model raises the pin-change interrupt for us
+//=========================================================================================================
+void CSimStimulus::add_button(batch_t& batch, uint64_t when_us, int state)
+{
+    batch.push_back(CSimScheduler::pin_event(when_us,                 CLICK_PIN,  state));
+    batch.push_back(CSimScheduler::pin_event(when_us +     BOUNCE_US, CLICK_PIN, !state));
+    batch.push_back(CSimScheduler::pin_event(when_us + 2 * BOUNCE_US, CLICK_PIN,  state));
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// add_turn() - Adds the events for a single detent of knob rotation to a batch.  Channel B is sampled
+//              on the rising edge of channel A, which is what raises the INT interrupt
+//=========================================================================================================
+void CSimStimulus::add_turn(batch_t& batch, uint64_t when_us, knob_event_t direction)
+{
+    int b_state = (direction == KNOB_RIGHT) ? 1 : 0;
+
+    batch.push_back(CSimScheduler::pin_event(when_us, CHANNEL_B, b_state));
+    batch.push_back(CSimScheduler::pin_event(when_us, CHANNEL_A, 0));
+    batch.push_back(CSimScheduler::pin_event(when_us, CHANNEL_A, 1));
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// do_serial() - Scheduled action for a "serial" line: delivers the text (and a line terminator) to the
+//               device's serial port
+//=========================================================================================================
+void CSimStimulus::do_serial(const char* text)
+{
+    sim_log("serial> %s\n", text);
+    Serial.inject(text, strlen(text));
+    Serial.inject("\n", 1);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// do_uart() - Scheduled action for a "uart" line: logs the serial port's traffic counters
+//=========================================================================================================
+void CSimStimulus::do_uart(const char*)
+{
+    const CArduinoSerial::stats_t& stats = Serial.get_stats();
+
+    sim_log("uart: %lu baud, rx %u bytes, %u overruns, tx %u bytes, %u dropped, stalled %.1f ms\n",
+            Serial.get_baud(), stats.rx_bytes, stats.rx_dropped, stats.tx_bytes, stats.tx_dropped,
+            stats.tx_stall_us / 1000.0);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// do_i2c() - Scheduled action for an "i2c" line: logs the I2C bus's traffic counters
+//=========================================================================================================
+void CSimStimulus::do_i2c(const char*)
+{
+    const CArduinoWire::stats_t& stats = Wire.get_stats();
+
+    sim_log("i2c: %lu kHz, %u transactions, %u bytes, %u nacks, busy %.3f ms\n",
+            (unsigned long)Wire.get_clock() / 1000, stats.transactions, stats.bytes, stats.nacks,
+            stats.bus_ns / 1000000.0);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// do_sht31() - Scheduled action for an "sht31" line: reprograms the temperature/humidity sensor
+//
+// The text is either "corrupt <count>" or "<temp_c> <rh> [<temp_swing> <rh_swing> <period_ms>]"
+//=========================================================================================================
+void CSimStimulus::do_sht31(const char* text)
+{
+    CSimSHT31& sensor = sim_device().sht31;
+    float temp_c, rh, temp_swing = 0, rh_swing = 0;
+    unsigned period_ms = 0;
+    int count;
+
+    if (sscanf(text, "corrupt %d", &count) == 1)
+        sensor.corrupt_crc(count);
+
+    else if (sscanf(text, "%f %f %f %f %u", &temp_c, &rh, &temp_swing, &rh_swing, &period_ms) >= 2)
+        sensor.set_environment(temp_c, rh, temp_swing, rh_swing, period_ms);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// do_display() - Scheduled action for a "display" line: logs the LED matrix image and what the most
+//                recent frame cost on the bus
+//=========================================================================================================
+void CSimStimulus::do_display(const char*)
+{
+    CSimIS31FL3731* matrix = sim_device().led_matrix;
+    const int cols = CSimIS31FL3731::COLS;
+
+    // The boards sit side by side
+    for (int row = 0; row < CSimIS31FL3731::ROWS; ++row)
+    {
+        char line[cols * LED_CHIPS + 1];
+        for (int col = 0; col < cols * LED_CHIPS; ++col) line[col] = matrix[col / cols].pixel(row, col % cols) ? '#' : '.';
+        line[cols * LED_CHIPS] = 0;
+        sim_log("display |%s|\n", line);
+    }
+
+    for (int i = 0; i < LED_CHIPS; ++i)
+    {
+        const CSimIS31FL3731::stats_t& stats = matrix[i].get_stats();
+        sim_log("display: %u frames, last %u bytes in %u transactions, peak %u bytes in %u transactions\n",
+                stats.frames, stats.last_bytes, stats.last_transactions, stats.peak_bytes, stats.peak_transactions);
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// do_eeprom() - Scheduled action for an "eeprom" line: either injects faults, or logs how many bytes were
+//               programmed and skipped and how long each CEEPROM API call took.  With "wear", it also logs
+//               every 16-byte line of the EEPROM that has been programmed at all
+//=========================================================================================================
+void CSimStimulus::do_eeprom(const char* text)
+{
+    static const char* api_name[CSimEEPROM::API_COUNT] = { "read", "write", "roll_back", "destroy", "write_async" };
+    CSimEEPROM& eeprom = SimEEPROM;
+    const CSimEEPROM::stats_t& stats = eeprom.get_stats();
+    int count;
+
+    if (sscanf(text, "fail %d", &count) == 1)
+    {
+        eeprom.inject_failures(count);
+        return;
+    }
+
+    if (sscanf(text, "flip %d", &count) == 1)
+    {
+        eeprom.inject_bit_flips(count);
+        return;
+    }
+
+    sim_log("eeprom: %u calls, %u bytes programmed, %u skipped, last %u programmed, %u skipped, peak wear %u at 0x%04X\n",
+            stats.calls, stats.programmed, stats.skipped, stats.last_programmed, stats.last_skipped,
+            stats.peak_wear, stats.peak_address);
+
+    for (int api = 0; api < CSimEEPROM::API_COUNT; ++api)
+    {
+        const CSimEEPROM::api_stats_t& timing = eeprom.get_api_stats(api);
+        if (timing.calls == 0) continue;
+        sim_log("eeprom %s: %u calls, last %.1f ms, peak %.1f ms, total %.1f ms\n", api_name[api], timing.calls,
+                timing.last_us / 1000.0, timing.peak_us / 1000.0, timing.total_us / 1000.0);
+    }
+
+    if (strcmp(text, "wear") != 0) return;
+
+    for (size_t line = 0; line < eeprom.size(); line += 16)
+    {
+        char buffer[16 * 11 + 1];
+        int  length = 0;
+        bool is_worn = false;
+
+        for (size_t address = line; address < line + 16 && address < eeprom.size(); ++address)
+        {
+            length += sprintf(buffer + length, " %u", eeprom.wear(address));
+            if (eeprom.wear(address)) is_worn = true;
+        }
+
+        if (is_worn) sim_log("eeprom wear %04X:%s\n", (unsigned)line, buffer);
+    }
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// do_expect() - Scheduled action for an "expect" line: checks that the text was logged since the
+//               previous "expect", then discards the transcript up to the end of the match
+//=========================================================================================================
+void CSimStimulus::do_expect(const char* text)
+{
+    std::string& transcript = SimStimulus.m_transcript;
+
+    size_t where = transcript.find(text);
+
+    if (where == std::string::npos)
+    {
+        fprintf(stderr, "FAIL @ %lu ms: expected \"%s\"\n", millis(), text);
+        ++SimStimulus.m_failures;
+    }
+    else
+    {
+        transcript.erase(0, where + strlen(text));
+    }
+
+    // Once the last "expect" has run, there's no reason to keep the transcript
+    if (--SimStimulus.m_pending_expects == 0) transcript.clear();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// do_end() - Scheduled action for an "end" line: tells the simulator to stop
+//=========================================================================================================
+void CSimStimulus::do_end(const char* text)
+{
+    SimStimulus.m_end_status = atoi(text);
+    SimStimulus.m_finished = true;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// parse_command() - Converts the command portion of a trace line into scheduled events
+//
+// Passed:  command = The text following the timestamp.  This gets modified
+//          when_us = The absolute virtual time of the stimulus
+//          batch   = The events get appended to this
+//
+// Returns: true if the command was understood
+//=========================================================================================================
+bool CSimStimulus::parse_command(char* command, uint64_t when_us, batch_t& batch)
+{
+    // Separate the verb from its arguments
+    char* verb = command + strspn(command, " \t");
+    char* args = verb + strcspn(verb, " \t");
+    if (*args) *args++ = 0;
+    if (*verb == 0) return false;
+    while (*args == ' ' || *args == '\t') ++args;
+
+    if (strcmp(verb, "turn") == 0)
+    {
+        char direction[16] = "";
+        int count = 1;
+        sscanf(args, "%15s %d", direction, &count);
+        if (count < 1) return false;
+
+        knob_event_t event;
+        if      (strcmp(direction, "left")  == 0) event = KNOB_LEFT;
+        else if (strcmp(direction, "right") == 0) event = KNOB_RIGHT;
+        else return false;
+
+        for (int i = 0; i < count; ++i) add_turn(batch, when_us + i * DETENT_SPACING_US, event);
+        return true;
+    }
+
+    if (strcmp(verb, "press") == 0)
+    {
+        add_button(batch, when_us, 0);
+        return true;
+    }
+
+    if (strcmp(verb, "release") == 0)
+    {
+        add_button(batch, when_us, 1);
+        return true;
+    }
+
+    if (strcmp(verb, "click") == 0)
+    {
+        add_button(batch, when_us, 0);
+        add_button(batch, when_us + CLICK_HOLD_US, 1);
+        return true;
+    }
+
+    if (strcmp(verb, "hold") == 0)
+    {
+        int hold_ms;
+        if (sscanf(args, "%d", &hold_ms) != 1 || hold_ms < 0) return false;
+        add_button(batch, when_us, 0);
+        add_button(batch, when_us + hold_ms * 1000ULL, 1);
+        return true;
+    }
+
+    if (strcmp(verb, "pin") == 0)
+    {
+        int pin, state;
+        if (sscanf(args, "%d %d", &pin, &state) != 2 || pin < 0 || pin > 255) return false;
+        batch.push_back(CSimScheduler::pin_event(when_us, pin, state != 0));
+        return true;
+    }
+
+    if (strcmp(verb, "serial") == 0)
+    {
+        batch.push_back(CSimScheduler::call_event(when_us, do_serial, args));
+        return true;
+    }
+
+    if (strcmp(verb, "uart") == 0)
+    {
+        batch.push_back(CSimScheduler::call_event(when_us, do_uart));
+        return true;
+    }
+
+    if (strcmp(verb, "i2c") == 0)
+    {
+        batch.push_back(CSimScheduler::call_event(when_us, do_i2c));
+        return true;
+    }
+
+    if (strcmp(verb, "display") == 0)
+    {
+        batch.push_back(CSimScheduler::call_event(when_us, do_display));
+        return true;
+    }
+
+    if (strcmp(verb, "eeprom") == 0)
+    {
+        int count;
+        bool is_fault = sscanf(args, "fail %d", &count) == 1 || sscanf(args, "flip %d", &count) == 1;
+        if (*args && strcmp(args, "wear") != 0 && !(is_fault && count >= 0)) return false;
+        batch.push_back(CSimScheduler::call_event(when_us, do_eeprom, args));
+        return true;
+    }
+
+    if (strcmp(verb, "sht31") == 0)
+    {
+        float temp_c, rh;
+        int count;
+        if (sscanf(args, "corrupt %d", &count) != 1 && sscanf(args, "%f %f", &temp_c, &rh) != 2) return false;
+        batch.push_back(CSimScheduler::call_event(when_us, do_sht31, args));
+        return true;
+    }
+
+    if (strcmp(verb, "expect") == 0)
+    {
+        if (*args == 0) return false;
+        batch.push_back(CSimScheduler::call_event(when_us, do_expect, args));
+        return true;
+    }
+
+    if (strcmp(verb, "end") == 0)
+    {
+        batch.push_back(CSimScheduler::call_event(when_us, do_end, args));
+        return true;
+    }
+
+    // If we get here, we don't recognize the command
+    return false;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// load() - Parses a trace and schedules every stimulus in it
+//
+// Passed:  trace    = The text of the trace
+//          filename = The name of the trace (for error messages)
+//
+// Times in the trace are relative to the moment it gets loaded, so a trace can be loaded into a device
+// that has already been running (a restored snapshot, for instance)
+//
+// Returns: true if the entire trace was parsed.  If it wasn't, nothing gets scheduled
+//=========================================================================================================
+bool CSimStimulus::load(const char* trace, const char* filename)
+{
+    char line[512];
+    batch_t batch;
+    int line_number = 0;
+    bool has_end = false;
+
+    // Timestamps in the trace are relative to this moment
+    uint64_t base_us = SimClock.micros();
+    uint64_t when_us = base_us, last_us = base_us;
+
+    // This is a fresh run: forget how any previous trace ended
+    m_transcript.clear();
+    m_pending_expects = 0;
+    m_failures   = 0;
+    m_finished   = false;
+    m_end_status = 0;
+
+    while (*trace)
+    {
+        ++line_number;
+
+        // Fetch the next line of the trace
+        size_t length = strcspn(trace, "\n");
+        if (length >= sizeof line) length = sizeof line - 1;
+        memcpy(line, trace, length);
+        line[length] = 0;
+        trace += strcspn(trace, "\n");
+        if (*trace) ++trace;
+
+        // Strip off comments and trailing whitespace
+        char* p = strchr(line, '#');
+        if (p) *p = 0;
+        p = line + strlen(line);
+        while (p > line && (p[-1] == ' ' || p[-1] == '\t' || p[-1] == '\r')) *--p = 0;
+
+        // Skip leading whitespace.  Blank lines are ignored
+        char* in = line;
+        while (*in == ' ' || *in == '\t') ++in;
+        if (*in == 0) continue;
+
+        // Parse the timestamp, which is either absolute or relative to the previous line
+        bool relative = (*in == '+');
+        if (relative) ++in;
+        char* after;
+        double ms = strtod(in, &after);
+        if (after == in || ms < 0)
+        {
+            fprintf(stderr, "%s(%d): bad timestamp\n", filename, line_number);
+            return false;
+        }
+        when_us = (uint64_t)(ms * 1000) + (relative ? when_us : base_us);
+
+        // And parse the command itself
+        size_t batch_size = batch.size();
+        if (!parse_command(after, when_us, batch))
+        {
+            fprintf(stderr, "%s(%d): bad command\n", filename, line_number);
+            return false;
+        }
+
+        // Keep track of the latest stimulus in the trace
+        if (batch.size() == batch_size) continue;
+        if (batch.back().when > last_us) last_us = batch.back().when;
+        if (batch.back().type == CSimScheduler::CALL && batch.back().fn == do_end) has_end = true;
+    }
+
+    // If the trace doesn't say when to end, give the firmware time to react to the last stimulus
+    if (!has_end) batch.push_back(CSimScheduler::call_event(last_us + DEFAULT_TAIL_US, do_end));
+
+    // The trace is good.  Schedule all of it
+    for (auto& event : batch)
+    {
+        if (event.type == CSimScheduler::CALL && event.fn == do_expect) ++m_pending_expects;
+        SimScheduler.schedule(event);
+    }
+    return true;
+}
+//=========================================================================================================
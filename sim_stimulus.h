@@ -0,0 +1,107 @@
+//=========================================================================================================
+// sim_stimulus.h - Defines the scripted stimulus player that replays a trace file into the simulator
+//
+// A trace is a text file with one stimulus per line:
+//
+//     <time> <command> [arguments]
+//
+// <time> is in milliseconds of virtual time.  A plain number is measured from the moment the trace is
+// loaded, a number prefixed with "+" is relative to the time on the previous line.  Blank lines and
+// anything after a "#" are ignored.
+//
+// Commands:
+//
+//     turn left|right [n]   = Rotate the knob by "n" detents (default 1)
+//     press                 = Push the knob button down (with contact bounce)
+//     release               = Let the knob button up (with contact bounce)
+//     click                 = A short press and release
+//     hold <ms>             = Press the button, then release it <ms> later
+//     pin <n> <0|1>         = Drive a raw pin edge
+//     serial <text>         = Send a line of text to the serial port (it arrives at the port's baud rate)
+//     uart                  = Log the serial port's traffic counters
+//     i2c                   = Log the I2C bus's traffic counters
+//     display               = Log the LED matrix image and what the most recent frame cost on the bus
+//     eeprom [wear]         = Log the EEPROM's wear counters and how long each CEEPROM API call blocked,
+//                             and optionally how often each worn byte was programmed
+//     eeprom fail <n>       = Make the next <n> EEPROM reads or writes fail
+//     eeprom flip <n>       = Flip a bit in each of the next <n> EEPROM bytes to be programmed
+//     sht31 <c> <rh> [<c_swing> <rh_swing> <period_ms>]
+//                           = Set the temperature and humidity the SHT31 sees, optionally swinging
+//                             sinusoidally around those values
+//     sht31 corrupt <n>     = Make the SHT31 send a bad CRC on its next <n> CRC bytes
+//     expect <text>         = Fail the run if <text> hasn't been logged since the previous "expect"
+//     end [status]          = Stop the simulation and exit with the given status (default 0)
+//
+// If the trace has no "end" command, the run ends 3 seconds (of virtual time) after the last stimulus.
+//=========================================================================================================
+#ifndef _SIM_STIMULUS_H_
+#define _SIM_STIMULUS_H_
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include "sim_sched.h"
+#include "rotary_knob.h"
+
+// Logs a line of simulator output.  Printed to stdout and recorded so that "expect" can check it
+void sim_log(const char* fmt, ...);
+
+class CSimStimulus
+{
+public:
+
+    // Exit status when a trace can't be parsed, and when an "expect" wasn't met
+    enum { EXIT_EXPECT_FAILED = 1, EXIT_BAD_TRACE = 2 };
+
+    // Constructor
+    CSimStimulus();
+
+    // Parses a trace and schedules every stimulus in it.  Returns false if the trace is malformed
+    bool    load(const char* trace, const char* filename);
+
+    // Returns true once an "end" command has been executed
+    bool    is_finished() { return m_finished; }
+
+    // The status the simulator should exit with
+    int     exit_status() { return (m_failures) ? EXIT_EXPECT_FAILED : m_end_status; }
+
+    // Records a line of output for the benefit of "expect"
+    void    record(const char* text);
+
+    // These build the pin events for knob activity.  They're shared with the interactive keyboard thread
+    typedef std::vector<CSimScheduler::event_t> batch_t;
+    static void add_button(batch_t& batch, uint64_t when_us, int state);
+    static void add_turn(batch_t& batch, uint64_t when_us, knob_event_t direction);
+
+    // How long (in microseconds) the simulated button bounces between state changes
+    enum { BOUNCE_US = 8000 };
+
+protected:
+
+    // Parses the command portion of a single trace line into a batch of events
+    bool    parse_command(char* command, uint64_t when_us, batch_t& batch);
+
+    // These are the actions that trace commands perform at their scheduled times
+    static void do_serial(const char* text);
+    static void do_uart(const char* text);
+    static void do_i2c(const char* text);
+    static void do_sht31(const char* text);
+    static void do_display(const char* text);
+    static void do_eeprom(const char* text);
+    static void do_expect(const char* text);
+    static void do_end(const char* text);
+
+    // Output that has been logged but not yet consumed by an "expect", and how many are still to run.
+    // With none left to run, nothing gets recorded
+    std::string m_transcript;
+    int         m_pending_expects;
+
+    // The number of "expect" commands that failed
+    int         m_failures;
+
+    // True once the "end" command has run, and the status it asked for
+    bool        m_finished;
+    int         m_end_status;
+};
+
+#endif
@@ -0,0 +1,327 @@
+//=========================================================================================================
+// sim_wire.cpp - Implements the simulated I2C bus that sits behind "Wire"
+//=========================================================================================================
+#include <string.h>
+#include "sim_device.h"
+#include "sim_i2c.h"
+#include <utility/twi.h>
+
+// The bus clock until the firmware calls setClock().  This is the AVR library's default
+#define DEFAULT_CLOCK_HZ 100000
+
+
+//=========================================================================================================
+// sim_wire() - The Wire macro uses this to find the current device's I2C bus
+//=========================================================================================================
+CArduinoWire& sim_wire() { return sim_device().wire; }
+//=========================================================================================================
+
+
+//=========================================================================================================
+// Constructor() - The bus starts out idle, with nothing attached to it
+//=========================================================================================================
+CArduinoWire::CArduinoWire()
+{
+    memset(m_device, 0, sizeof m_device);
+    m_holder = nullptr;
+    m_clock = DEFAULT_CLOCK_HZ;
+    m_owed_ns = 0;
+    m_tx_length = m_tx_address = 0;
+    m_rx_length = m_rx_index = 0;
+    memset(&m_stats, 0, sizeof m_stats);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// operator=() - Copies the state of another bus.  Our own device models stay attached
+//=========================================================================================================
+CArduinoWire& CArduinoWire::operator=(const CArduinoWire& rhs)
+{
+    // The bus holder is one of the other bus's device models.  Find the same address on ours
+    m_holder = nullptr;
+    if (rhs.m_holder) for (int address = 0; address < 128; ++address)
+    {
+        if (rhs.m_device[address] == rhs.m_holder) m_holder = m_device[address];
+    }
+
+    m_clock      = rhs.m_clock;
+    m_owed_ns    = rhs.m_owed_ns;
+    m_tx_length  = rhs.m_tx_length;
+    m_tx_address = rhs.m_tx_address;
+    m_rx_length  = rhs.m_rx_length;
+    m_rx_index   = rhs.m_rx_index;
+    m_stats      = rhs.m_stats;
+    memcpy(m_tx_buffer, rhs.m_tx_buffer, sizeof m_tx_buffer);
+    memcpy(m_rx_buffer, rhs.m_rx_buffer, sizeof m_rx_buffer);
+    return *this;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// attach() - Attaches a device model to the bus at a 7-bit address
+//=========================================================================================================
+void CArduinoWire::attach(uint8_t address, CSimI2CDevice* device)
+{
+    if (address < 128) m_device[address] = device;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// charge() - Adds some bit-times to the bus time we owe
+//=========================================================================================================
+void CArduinoWire::charge(uint32_t bits)
+{
+    uint64_t ns = bits * 1000000000ULL / m_clock;
+    m_owed_ns += ns;
+    m_stats.bus_ns += ns;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// wait_for_bus() - Busy-waits (in virtual time) for the transaction we just performed.  Fractions of a
+//                  microsecond are carried over to the next transaction
+//=========================================================================================================
+void CArduinoWire::wait_for_bus()
+{
+    uint64_t us = m_owed_ns / 1000;
+    m_owed_ns %= 1000;
+    if (us) sim_wait(SimClock.micros() + us);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// start() - Issues a START (or a repeated START) followed by the address byte
+//
+// Returns: The device that ACKed the address, or nullptr
+//=========================================================================================================
+CSimI2CDevice* CArduinoWire::start(uint8_t address, bool is_read)
+{
+    ++m_stats.transactions;
+
+    // If someone else is holding the bus, this repeated START ends their transaction
+    CSimI2CDevice* device = (address < 128) ? m_device[address] : nullptr;
+    if (m_holder && m_holder != device) m_holder->on_stop();
+    m_holder = nullptr;
+
+    // The START condition plus the address byte and its ACK
+    charge(1 + 9);
+
+    // Does anyone answer to this address?
+    if (device == nullptr || !device->on_start(is_read))
+    {
+        ++m_stats.nacks;
+        return nullptr;
+    }
+
+    return device;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// stop() - Issues a STOP
+//=========================================================================================================
+void CArduinoWire::stop()
+{
+    if (m_holder) m_holder->on_stop();
+    m_holder = nullptr;
+    charge(1);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// transmit() - Writes a block of data to a device
+//
+// Passed:  address   = The 7-bit address of the device
+//          data      = The bytes to write
+//          length    = How many bytes to write
+//          send_stop = If false, the bus is held for a repeated START
+//
+// Returns: One of the I2C_xxx results
+//=========================================================================================================
+uint8_t CArduinoWire::transmit(uint8_t address, const uint8_t* data, size_t length, bool send_stop)
+{
+    uint8_t result = I2C_OK;
+
+    // Address the device
+    CSimI2CDevice* device = start(address, false);
+
+    // If it ACKed, send it the data until it's all sent or the device NACKs
+    if (device == nullptr)
+        result = I2C_ADDRESS_NACK;
+    else for (size_t i = 0; i < length; ++i)
+    {
+        charge(9);
+        ++m_stats.bytes;
+        if (!device->on_write(data[i]))
+        {
+            ++m_stats.nacks;
+            result = I2C_DATA_NACK;
+            break;
+        }
+    }
+
+    // A NACK always ends with a STOP.  Otherwise, the caller may want to hold the bus
+    m_holder = device;
+    if (send_stop || result != I2C_OK) stop();
+
+    // And let the transaction take as long as it would on the real bus
+    wait_for_bus();
+    return result;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// receive() - Reads a block of data from a device
+//
+// Passed:  address   = The 7-bit address of the device
+//          data      = Where to store the bytes
+//          length    = How many bytes to read
+//          send_stop = If false, the bus is held for a repeated START
+//
+// Returns: The number of bytes read.  0 if the device didn't answer
+//=========================================================================================================
+size_t CArduinoWire::receive(uint8_t address, uint8_t* data, size_t length, bool send_stop)
+{
+    // Address the device
+    CSimI2CDevice* device = start(address, true);
+
+    // If nobody answered, there's nothing to read
+    if (device == nullptr)
+    {
+        stop();
+        wait_for_bus();
+        return 0;
+    }
+
+    // The device may hold the clock low until it has something to send
+    uint64_t stretch_ns = device->on_stretch() * 1000ULL;
+    m_owed_ns += stretch_ns;
+    m_stats.bus_ns += stretch_ns;
+
+    // Clock in the data.  The master ACKs every byte but the last
+    for (size_t i = 0; i < length; ++i)
+    {
+        charge(9);
+        ++m_stats.bytes;
+        data[i] = device->on_read();
+    }
+
+    // Release the bus, unless the caller wants to hold it
+    m_holder = device;
+    if (send_stop) stop();
+
+    // And let the transaction take as long as it would on the real bus
+    wait_for_bus();
+    return length;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// beginTransmission() - Starts filling the transmit buffer for a device
+//=========================================================================================================
+void CArduinoWire::beginTransmission(uint8_t address)
+{
+    m_tx_address = address;
+    m_tx_length = 0;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// write() - Adds data to the transmit buffer.  Like the AVR library, whatever doesn't fit is discarded
+//
+// Returns: The number of bytes that fit
+//=========================================================================================================
+size_t CArduinoWire::write(uint8_t data)
+{
+    if (m_tx_length >= BUFFER_LENGTH) return 0;
+    m_tx_buffer[m_tx_length++] = data;
+    return 1;
+}
+
+size_t CArduinoWire::write(const void* buffer, size_t length)
+{
+    const uint8_t* in = (const uint8_t*)buffer;
+    size_t count = 0;
+    while (count < length && write(in[count])) ++count;
+    return count;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// endTransmission() - Sends the transmit buffer to the device
+//
+// Returns: One of the I2C_xxx results
+//=========================================================================================================
+uint8_t CArduinoWire::endTransmission(bool send_stop)
+{
+    uint8_t result = transmit(m_tx_address, m_tx_buffer, m_tx_length, send_stop);
+    m_tx_length = 0;
+    return result;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// requestFrom() - Reads data from a device into the receive buffer
+//
+// Returns: The number of bytes read
+//=========================================================================================================
+uint8_t CArduinoWire::requestFrom(uint8_t address, uint8_t quantity, bool send_stop)
+{
+    if (quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+    m_rx_length = (uint8_t)receive(address, m_rx_buffer, quantity, send_stop);
+    m_rx_index = 0;
+    return m_rx_length;
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// read() and peek() - Fetch the next byte from the receive buffer, or -1 if there isn't one
+//=========================================================================================================
+int CArduinoWire::read()
+{
+    if (m_rx_index >= m_rx_length) return -1;
+    return m_rx_buffer[m_rx_index++];
+}
+
+int CArduinoWire::peek()
+{
+    if (m_rx_index >= m_rx_length) return -1;
+    return m_rx_buffer[m_rx_index];
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// The <utility/twi.h> routines.  These run on the current device's bus, same as Wire
+//=========================================================================================================
+void twi_init() { Wire.begin(); }
+
+void twi_disable() { Wire.end(); }
+
+void twi_setFrequency(uint32_t frequency) { Wire.setClock(frequency); }
+
+uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t /* wait */, uint8_t send_stop)
+{
+    if (length > TWI_BUFFER_LENGTH) return CArduinoWire::I2C_TOO_LONG;
+    return Wire.transmit(address, data, length, send_stop != 0);
+}
+
+uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t send_stop)
+{
+    if (length > TWI_BUFFER_LENGTH) return 0;
+    return (uint8_t)Wire.receive(address, data, length, send_stop != 0);
+}
+//=========================================================================================================
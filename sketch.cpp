@@ -0,0 +1,90 @@
+//=========================================================================================================
+// sketch.cpp - Implements the firmware "sketch" that runs on each simulated device
+//=========================================================================================================
+#include <Arduino.h>
+#include "sketch.h"
+#include "common.h"
+#include "globals.h"
+
+
+//=========================================================================================================
+// setup() - Called once at power-up
+//=========================================================================================================
+void CSketch::setup()
+{
+    Serial.begin(SERIAL_BAUD);
+    EEPROM.read();
+    Wire.begin();
+    Wire.setClock(400000);
+    Knob.init(CHANNEL_A, CHANNEL_B, CLICK_PIN);
+    Display.init(LED_I2C_ADDRESS);
+    Display.set_background(true);
+    Display.set_binary_mode(true, false);
+    m_value = 0;
+    m_is_alarm = false;
+    Display.print(m_value);
+    m_oneshot.start(2000);
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// loop() - Called repeatedly by the host loop
+//=========================================================================================================
+void CSketch::loop()
+{
+    knob_event_t event;
+
+    if (Knob.get_event(&event)) switch (event)
+    {
+        case KNOB_UP:
+            sim_log("Button Up\n");
+            break;
+
+        case KNOB_LPRESS:
+            sim_log("Button LongPress\n");
+            toggle_alarm();
+            break;
+
+        case KNOB_LEFT:
+            sim_log("Turn Left\n");
+            if (m_value > -99) Display.print(--m_value);
+            break;
+
+        case KNOB_RIGHT:
+            sim_log("Turn Right\n");
+            if (m_value < 999) Display.print(++m_value);
+            break;
+    }
+
+    if (m_timer.is_expired()) sim_log("Timer expired\n");
+    if (m_oneshot.is_expired()) sim_log("Oneshot expired\n");
+
+    m_server.execute();
+    Display.service();
+}
+//=========================================================================================================
+
+
+//=========================================================================================================
+// toggle_alarm() - Starts or stops blinking the value on the display.  The display chip alternates
+//                  between the value and a blank frame on its own
+//=========================================================================================================
+void CSketch::toggle_alarm()
+{
+    m_is_alarm = !m_is_alarm;
+
+    if (m_is_alarm)
+    {
+        Display.store_frame(2);
+        Display.clear_frame(3);
+        Display.breathe(26, 26);
+        Display.autoplay(2, 2, 440);
+    }
+    else
+    {
+        Display.stop_breathing();
+        Display.stop_animation();
+    }
+}
+//=========================================================================================================
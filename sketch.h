@@ -0,0 +1,39 @@
+//=========================================================================================================
+// sketch.h - Defines the firmware "sketch" that runs on each simulated device
+//
+// This is the equivalent of an Arduino .ino file: setup() is called once, then loop() is called
+// over and over.  Anything the sketch would normally keep in global variables lives in here instead,
+// so that every simulated device gets its own copy
+//=========================================================================================================
+#ifndef _SKETCH_H_
+#define _SKETCH_H_
+#include "mstimer.h"
+#include "serialserver.h"
+
+class CSketch
+{
+public:
+
+    // Called once at power-up
+    void    setup();
+
+    // Called repeatedly, forever
+    void    loop();
+
+protected:
+
+    msTimer m_timer;
+    OneShot m_oneshot;
+
+    // The number on the display.  Turning the knob changes it
+    int     m_value;
+
+    // A long-press of the knob toggles a blinking "alarm" display, animated by the display chip
+    bool    m_is_alarm;
+    void    toggle_alarm();
+
+    // Handles commands arriving on the serial port
+    CSerialServer m_server;
+};
+
+#endif
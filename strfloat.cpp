@@ -21,6 +21,7 @@
 //  Notes:
 //    The output buffer is 20 bytes long.  Don't overflow it!  Using a static buffer here makes this
 //    routine convenient to use, but makes it unsuitable for use in multi-threaded environment.  
+//    (In the simulator, where each thread runs a separate device, each thread gets its own buffer)
 //
 // 
 // To test:
@@ -29,7 +30,11 @@
 //=========================================================================================================
 const char* strfloat(float value, int8_t width, int8_t decimals)
 {
+#ifdef __AVR__
     static char buffer[20];
+#else
+    static thread_local char buffer[20];
+#endif
     char        digit, * out = buffer;
     uint32_t    divisor, whole, part;
     int8_t      i, div_count;